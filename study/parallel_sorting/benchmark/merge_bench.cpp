@@ -0,0 +1,124 @@
+// Слияние k ранов в памяти, без диска: прежняя куча priority_queue
+// против LoserTree
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/include/LoserTree.hpp"
+
+template<typename T>
+struct HeapNode {
+    T value;
+    size_t chunkIndex;
+};
+
+// Цикл слияния mergeChunksToFile до LoserTree
+template<typename T, typename Sink>
+void heapMerge(const std::vector<std::vector<T>>& runs, Sink&& sink) {
+    using Node = HeapNode<T>;
+    auto cmp = [](const Node& a, const Node& b) { return b.value < a.value; };
+    std::priority_queue<Node, std::vector<Node>, decltype(cmp)> heap(cmp);
+    std::vector<size_t> pos(runs.size(), 0);
+
+    for (size_t i = 0; i < runs.size(); ++i)
+        if (!runs[i].empty()) heap.push({runs[i][pos[i]++], i});
+
+    while (!heap.empty()) {
+        auto cur = heap.top(); heap.pop();
+        sink(cur.value);
+        size_t idx = cur.chunkIndex;
+        if (pos[idx] < runs[idx].size())
+            heap.push({runs[idx][pos[idx]++], idx});
+    }
+}
+
+// Как в mergeRuns: головы ранов лежат в одном массиве
+template<typename T, typename Sink>
+void loserTreeMerge(const std::vector<std::vector<T>>& runs, Sink&& sink) {
+    const size_t k = runs.size();
+    std::vector<size_t> pos(k, 0);
+    std::vector<T> heads(k);
+    std::vector<char> alive(k);
+    auto advance = [&](size_t i) {
+        alive[i] = pos[i] < runs[i].size();
+        if (alive[i]) heads[i] = runs[i][pos[i]++];
+    };
+    for (size_t i = 0; i < k; ++i) advance(i);
+
+    LoserTree<T, std::less<T>> tree(heads, alive, std::less<T>());
+    while (!tree.empty()) {
+        const size_t w = tree.winner();
+        sink(heads[w]);
+        advance(w);
+        tree.replay();
+    }
+}
+
+template<typename T, typename Gen>
+std::vector<std::vector<T>> makeRuns(size_t total, size_t k, Gen gen) {
+    std::vector<std::vector<T>> runs(k);
+    for (size_t i = 0; i < total; ++i)
+        runs[i % k].push_back(gen());
+    for (auto& run : runs)
+        std::sort(run.begin(), run.end());
+    return runs;
+}
+
+// Контрольная сумма зависит от порядка: значение не на своём месте даст MISMATCH
+template<typename T>
+void fold(std::uint64_t& check, const T& value) {
+    check = check * 31 + std::hash<T>{}(value);
+}
+
+template<typename Fn>
+double timeMs(Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename T, typename Gen>
+void bench(const char* label, size_t total, Gen gen) {
+    for (size_t k : {8, 64, 512}) {
+        auto runs = makeRuns<T>(total, k, gen);
+        std::uint64_t checkHeap = 0, checkTree = 0;
+
+        double heapMs = timeMs([&] {
+            heapMerge(runs, [&](const T& v) { fold(checkHeap, v); });
+        });
+        double treeMs = timeMs([&] {
+            loserTreeMerge(runs, [&](const T& v) { fold(checkTree, v); });
+        });
+
+        std::cout << std::left << std::setw(8) << label
+                  << " k=" << std::setw(4) << k
+                  << " heap: " << std::setw(9) << std::fixed << std::setprecision(1) << heapMs << " ms"
+                  << "  loser tree: " << std::setw(9) << treeMs << " ms"
+                  << "  speedup: " << std::setprecision(2) << heapMs / treeMs << "x"
+                  << (checkHeap == checkTree ? "" : "  MISMATCH") << "\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t total = argc > 1 ? std::stoull(argv[1]) : 8'000'000;
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int> ints;
+    bench<int>("int", total, [&] { return ints(rng); });
+
+    std::uniform_int_distribution<int> len(5, 15), letter('a', 'z');
+    bench<std::string>("string", total / 4, [&] {
+        std::string s(len(rng), ' ');
+        for (auto& c : s) c = static_cast<char>(letter(rng));
+        return s;
+    });
+    return 0;
+}
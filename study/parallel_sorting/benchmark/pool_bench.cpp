@@ -0,0 +1,127 @@
+// Накладные расходы планировщика: пустые задачи на ThreadPool и
+// WorkStealingPool, вложенный fork/join — только на WorkStealingPool
+// (ThreadPool не умеет ждать изнутри задачи)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <latch>
+#include <string>
+#include <thread>
+
+#include "../src/include/ThreadPool.hpp"
+#include "../src/include/WorkStealingPool.hpp"
+
+template<typename Fn>
+double timeMs(Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Замеряется второй прогон: без запуска потоков и первых аллокаций
+template<typename Batch>
+double steadyMs(Batch batch) {
+    batch();
+    return timeMs(batch);
+}
+
+void emptyTasks(size_t threads, size_t count) {
+    std::atomic<size_t> sink{0};
+
+    ThreadPool mutexPool(threads);
+    double mutexMs = steadyMs([&] {
+        std::latch done(static_cast<std::ptrdiff_t>(count));
+        for (size_t i = 0; i < count; ++i)
+            mutexPool.enqueue([&] { done.count_down(); });
+        done.wait();
+    });
+
+    WorkStealingPool pool(threads);
+
+    // Из основного потока — через очередь инъекции
+    double injectedMs = steadyMs([&] {
+        WorkStealingPool::Group group;
+        for (size_t i = 0; i < count; ++i)
+            pool.spawn(group, [&] { sink.fetch_add(1, std::memory_order_relaxed); });
+        pool.wait(group);
+    });
+
+    // С воркера — в его деку, остальные крадут
+    double stealingMs = steadyMs([&] {
+        WorkStealingPool::Group root;
+        pool.spawn(root, [&] {
+            WorkStealingPool::Group group;
+            for (size_t i = 0; i < count; ++i)
+                pool.spawn(group, [&] { sink.fetch_add(1, std::memory_order_relaxed); });
+            pool.wait(group);
+        });
+        pool.wait(root);
+    });
+
+    std::cout << "empty tasks  n=" << std::setw(9) << count
+              << "  ThreadPool: " << std::setw(9) << std::fixed << std::setprecision(1) << mutexMs << " ms"
+              << " (" << std::setprecision(0) << mutexMs * 1e6 / count << " ns/task)"
+              << "  injected: " << std::setprecision(1) << std::setw(9) << injectedMs << " ms"
+              << " (" << std::setprecision(0) << injectedMs * 1e6 / count << " ns/task)"
+              << "  spawned on worker: " << std::setprecision(1) << std::setw(9) << stealingMs << " ms"
+              << " (" << std::setprecision(0) << stealingMs * 1e6 / count << " ns/task)"
+              << (sink.load() == 4 * count ? "" : "  MISMATCH") << "\n";
+}
+
+// volatile не даёт свернуть последовательную рекурсию в 2^depth
+volatile uint64_t leafValue = 1;
+
+uint64_t serialTree(unsigned depth) {
+    if (depth == 0) return leafValue;
+    return serialTree(depth - 1) + serialTree(depth - 1);
+}
+
+uint64_t forkJoinTree(WorkStealingPool& pool, unsigned depth) {
+    if (depth == 0) return leafValue;
+    uint64_t left = 0;
+    WorkStealingPool::Group group;
+    pool.spawn(group, [&pool, &left, depth] { left = forkJoinTree(pool, depth - 1); });
+    uint64_t right = forkJoinTree(pool, depth - 1);
+    pool.wait(group);
+    return left + right;
+}
+
+void forkJoin(size_t threads, unsigned depth) {
+    volatile uint64_t serialLeaves = 0;
+    double serialMs = timeMs([&] { serialLeaves = serialTree(depth); });
+
+    uint64_t leaves = 0;
+    double stealingMs = 0;
+    {
+        WorkStealingPool pool(threads);
+        stealingMs = timeMs([&] {
+            // Корень — задача, чтобы всё дерево порождалось в деки воркеров
+            WorkStealingPool::Group root;
+            pool.spawn(root, [&] { leaves = forkJoinTree(pool, depth); });
+            pool.wait(root);
+        });
+    }
+
+    const double spawns = static_cast<double>((uint64_t{1} << depth) - 1);
+    std::cout << "fork/join    depth=" << std::setw(2) << depth
+              << "  serial: " << std::setw(8) << std::fixed << std::setprecision(2) << serialMs << " ms"
+              << "  WorkStealingPool: " << std::setw(9) << stealingMs << " ms"
+              << " (" << std::setprecision(0) << stealingMs * 1e6 / spawns << " ns/spawn)"
+              << (leaves == serialLeaves ? "" : "  MISMATCH") << "\n";
+}
+
+int main(int argc, char** argv) {
+    size_t threads = argc > 1 ? std::stoul(argv[1])
+                              : std::max(1u, std::thread::hardware_concurrency());
+    std::cout << "threads: " << threads << "\n";
+
+    for (size_t count : {100'000, 1'000'000})
+        emptyTasks(threads, count);
+    for (unsigned depth = 10; depth <= 20; depth += 2)
+        forkJoin(threads, depth);
+    return 0;
+}
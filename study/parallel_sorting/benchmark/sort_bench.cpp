@@ -0,0 +1,479 @@
+// Сквозной бенчмарк сортировок на данных из фиксированного seed. Каждый
+// случай идёт в отдельном процессе, чтобы пиковая память была только его
+// (см. README)
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/include/mergeSorting.hpp"
+#include "../src/include/quickSort.hpp"
+#include "../src/include/radixSort.hpp"
+#include "../src/include/stringSort.hpp"
+#include "../src/include/MappedInput.hpp"
+#include "../src/include/OutputWriter.hpp"
+
+// Как в sort: внешняя сортировка берёт отсюда размер пулов
+const unsigned max_threads = 11;
+
+constexpr std::uint64_t SEED = 20240601;
+
+// ---------- Наборы данных ----------
+
+const std::vector<std::string> ALL_DATASETS = {"uniform", "sorted", "reverse", "few-unique", "zipf", "strings"};
+
+bool isStringDataset(const std::string& name) { return name == "strings"; }
+
+// FNV-1a, а не std::hash: одни и те же данные на любой стандартной библиотеке
+std::uint64_t seedFor(const std::string& dataset, size_t n) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : dataset) hash = (hash ^ c) * 1099511628211ull;
+    return SEED ^ hash ^ (static_cast<std::uint64_t>(n) << 20);
+}
+
+std::vector<int> makeInts(const std::string& kind, size_t n) {
+    std::mt19937_64 rng(seedFor(kind, n));
+    std::vector<int> data(n);
+    if (kind == "sorted" || kind == "reverse") {
+        for (size_t i = 0; i < n; ++i) data[i] = static_cast<int>(kind == "sorted" ? i : n - i);
+    } else if (kind == "few-unique") {
+        std::uniform_int_distribution<int> value(0, 15);
+        for (auto& v : data) v = value(rng) * 1000003;
+    } else if (kind == "zipf") {
+        // Обратная функция распределения по 64K рангам; ранги перемешаны
+        // хешем, чтобы частые значения не были заодно наименьшими
+        constexpr size_t RANKS = 1 << 16;
+        std::vector<double> cdf(RANKS);
+        double total = 0;
+        for (size_t r = 0; r < RANKS; ++r) cdf[r] = total += 1.0 / std::pow(static_cast<double>(r + 1), 1.1);
+        std::uniform_real_distribution<double> u(0, total);
+        for (auto& v : data) {
+            const auto rank = static_cast<std::uint32_t>(std::lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin());
+            v = static_cast<int>(rank * 2654435761u);
+        }
+    } else {
+        std::uniform_int_distribution<int> value;
+        for (auto& v : data) v = value(rng);
+    }
+    return data;
+}
+
+std::vector<std::string> makeStrings(size_t n) {
+    std::mt19937_64 rng(seedFor("strings", n));
+    std::uniform_int_distribution<size_t> length(1, 64);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    std::vector<std::string> data(n);
+    for (auto& s : data) {
+        s.resize(length(rng));
+        for (auto& c : s) c = static_cast<char>(letter(rng));
+    }
+    return data;
+}
+
+template<typename T>
+std::vector<T> makeData(const std::string& dataset, size_t n) {
+    if constexpr (std::is_same_v<T, std::string>) return makeStrings(n);
+    else return makeInts(dataset, n);
+}
+
+template<typename T>
+double payloadBytes(const std::vector<T>& data) {
+    if constexpr (std::is_same_v<T, std::string>) {
+        double bytes = 0;
+        for (const auto& s : data) bytes += static_cast<double>(s.size());
+        return bytes;
+    } else {
+        return static_cast<double>(data.size() * sizeof(T));
+    }
+}
+
+// ---------- Алгоритмы ----------
+
+const std::vector<std::string> ALL_ALGOS = {"quick", "parallel-quick", "merge", "radix", "string-msd",
+                                            "std-sort", "std-stable-sort", "external"};
+
+bool isParallel(const std::string& algo) {
+    return algo == "parallel-quick" || algo == "radix" || algo == "string-msd";
+}
+
+bool applies(const std::string& algo, const std::string& dataset) {
+    if (algo == "radix") return !isStringDataset(dataset);
+    if (algo == "string-msd") return isStringDataset(dataset);
+    return true;
+}
+
+// ---------- Пиковая память ----------
+
+// Сбрасывает VmHWM до текущего RSS, чтобы в пик не входила генерация данных
+void resetPeakRss() {
+    std::ofstream("/proc/self/clear_refs") << "5";
+}
+
+long peakRssKb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+        if (line.rfind("VmHWM:", 0) == 0) return std::atol(line.c_str() + 6);
+    struct rusage usage{};
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// ---------- Один случай, в дочернем процессе ----------
+
+struct Case {
+    std::string algo;
+    std::string dataset;
+    size_t elements = 0;
+    size_t threads = 1;
+};
+
+struct CaseResult {
+    double seconds = 0;
+    double bytes = 0;
+    long peakKb = 0;
+    bool sorted = false;
+};
+
+struct Options {
+    int reps = 3;
+    std::string tmpDir = ".";
+};
+
+template<typename Fn>
+double timeSeconds(Fn fn) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Внешняя сортировка текстового файла; запись входа в замер не входит
+template<typename T>
+double runExternal(std::vector<T>& data, const Options& options, bool& sorted) {
+    const std::string base = options.tmpDir + "/sort_bench_" + std::to_string(::getpid());
+    const std::string input = base + ".txt", output = base + ".out";
+    {
+        OutputWriter out(input);
+        out.writeAll(data);
+        out.close();
+    }
+    ExternalSortConfig config;
+    // Четверть данных — даже на малых размерах получается несколько ранов
+    config.memoryBudget = std::max<std::uint64_t>(1 << 20, static_cast<std::uint64_t>(payloadBytes(data) / 4));
+    std::vector<T>().swap(data);
+    resetPeakRss();
+
+    const double seconds = timeSeconds([&] {
+        int runs = 0;
+        if (generateSortedRuns<T>(input, runs, config)) mergeChunksToFile<T>(input, runs, output, config);
+    });
+
+    MappedInput result(output);
+    if constexpr (std::is_same_v<T, std::string>) {
+        const auto lines = result.lines(0);
+        sorted = std::is_sorted(lines.begin(), lines.end());
+    } else {
+        const auto values = result.values<T>();
+        sorted = std::is_sorted(values.begin(), values.end());
+    }
+    result.close();
+    std::remove(input.c_str());
+    std::remove(output.c_str());
+    return seconds;
+}
+
+template<typename T>
+CaseResult runCase(const Case& c, const Options& options) {
+    std::unique_ptr<WorkStealingPool> stealing;
+    std::unique_ptr<ThreadPool> pool;
+    if (c.algo == "parallel-quick" || c.algo == "string-msd") stealing = std::make_unique<WorkStealingPool>(c.threads);
+    if (c.algo == "radix") pool = std::make_unique<ThreadPool>(c.threads);
+
+    CaseResult result;
+    result.sorted = true;
+    std::vector<double> times;
+    for (int rep = 0; rep < options.reps; ++rep) {
+        std::vector<T> data = makeData<T>(c.dataset, c.elements);
+        result.bytes = payloadBytes(data);
+        resetPeakRss();
+        bool sorted = true;
+        double seconds = 0;
+        if (c.algo == "external") {
+            seconds = runExternal(data, options, sorted);
+        } else {
+            seconds = timeSeconds([&] {
+                if (c.algo == "quick") quickSort(data);
+                else if (c.algo == "parallel-quick") parallelQuickSort(data, *stealing);
+                else if (c.algo == "merge") data = mergeSort<T>(std::move(data));
+                else if (c.algo == "std-sort") std::sort(data.begin(), data.end());
+                else if (c.algo == "std-stable-sort") std::stable_sort(data.begin(), data.end());
+                else if constexpr (std::is_arithmetic_v<T>) {
+                    radixSort(data, false, pool.get());
+                } else {
+                    StringArena arena;
+                    size_t bytes = 0;
+                    for (const auto& s : data) bytes += s.size();
+                    arena.reserve(data.size(), bytes);
+                    for (const auto& s : data) arena.add(s);
+                    stringSort(arena, false, stealing.get());
+                    for (size_t i = 0; i < data.size(); ++i) {
+                        const std::string_view v = arena.view(arena.records[i]);
+                        data[i].assign(v.data(), v.size());
+                    }
+                }
+            });
+            sorted = std::is_sorted(data.begin(), data.end());
+        }
+        result.peakKb = std::max(result.peakKb, peakRssKb());
+        result.sorted = result.sorted && sorted;
+        times.push_back(seconds);
+    }
+    std::sort(times.begin(), times.end());
+    result.seconds = times[times.size() / 2];
+    return result;
+}
+
+// Запускает случай в дочернем процессе, результат приходит через pipe
+bool runIsolated(const Case& c, const Options& options, CaseResult& result) {
+    int fds[2];
+    if (::pipe(fds) != 0) return false;
+    std::cout.flush();
+    const pid_t pid = ::fork();
+    if (pid < 0) return false;
+    if (pid == 0) {
+        ::close(fds[0]);
+        const int devNull = ::open("/dev/null", O_WRONLY);
+        if (devNull >= 0) ::dup2(devNull, STDOUT_FILENO);
+        const CaseResult r = isStringDataset(c.dataset) ? runCase<std::string>(c, options) : runCase<int>(c, options);
+        const bool sent = ::write(fds[1], &r, sizeof(r)) == static_cast<ssize_t>(sizeof(r));
+        std::_Exit(sent ? 0 : 1);
+    }
+    ::close(fds[1]);
+    const bool received = ::read(fds[0], &result, sizeof(result)) == static_cast<ssize_t>(sizeof(result));
+    ::close(fds[0]);
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    return received && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// ---------- Отчёт ----------
+
+struct Row {
+    Case c;
+    CaseResult r;
+    double efficiency = -1;   // < 0 — случай без масштабирования по потокам
+};
+
+std::string keyOf(const Case& c) {
+    return c.algo + "," + c.dataset + "," + std::to_string(c.elements) + "," + std::to_string(c.threads);
+}
+
+void writeCsv(std::ostream& out, const std::vector<Row>& rows) {
+    out << "algorithm,dataset,elements,threads,seconds,elements_per_s,mb_per_s,peak_rss_kb,"
+           "scaling_efficiency,sorted\n";
+    for (const auto& row : rows) {
+        out << keyOf(row.c) << "," << std::setprecision(6) << row.r.seconds << ","
+            << std::setprecision(0) << std::fixed << row.c.elements / row.r.seconds << ","
+            << std::setprecision(2) << row.r.bytes / 1e6 / row.r.seconds << "," << row.r.peakKb << ",";
+        if (row.efficiency >= 0) out << std::setprecision(3) << row.efficiency;
+        out << "," << (row.r.sorted ? "true" : "false") << "\n";
+        out.unsetf(std::ios::fixed);
+    }
+}
+
+void writeJson(std::ostream& out, const std::vector<Row>& rows, const Options& options) {
+    out << "{\n  \"seed\": " << SEED << ",\n  \"reps\": " << options.reps
+        << ",\n  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n  \"results\": [\n";
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const auto& row = rows[i];
+        out << "    {\"algorithm\": \"" << row.c.algo << "\", \"dataset\": \"" << row.c.dataset
+            << "\", \"elements\": " << row.c.elements << ", \"threads\": " << row.c.threads
+            << ", \"seconds\": " << std::setprecision(6) << row.r.seconds << std::fixed
+            << ", \"elements_per_s\": " << std::setprecision(0) << row.c.elements / row.r.seconds
+            << ", \"mb_per_s\": " << std::setprecision(2) << row.r.bytes / 1e6 / row.r.seconds
+            << ", \"peak_rss_kb\": " << row.r.peakKb << ", \"scaling_efficiency\": ";
+        if (row.efficiency >= 0) out << std::setprecision(3) << row.efficiency;
+        else out << "null";
+        out << ", \"sorted\": " << (row.r.sorted ? "true" : "false") << "}" << (i + 1 < rows.size() ? "," : "")
+            << "\n";
+        out.unsetf(std::ios::fixed);
+    }
+    out << "  ]\n}\n";
+}
+
+// Случаи, ставшие медленнее прошлого --csv больше чем на tolerance
+int compareBaseline(const std::string& path, const std::vector<Row>& rows, double tolerance) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Cannot read baseline " << path << "\n";
+        return 1;
+    }
+    std::map<std::string, double> baseline;
+    std::string line;
+    std::getline(in, line);   // заголовок
+    while (std::getline(in, line)) {
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        for (std::string field; std::getline(ss, field, ',');) fields.push_back(field);
+        if (fields.size() >= 5)
+            baseline[fields[0] + "," + fields[1] + "," + fields[2] + "," + fields[3]] = std::atof(fields[4].c_str());
+    }
+
+    int regressions = 0;
+    for (const auto& row : rows) {
+        const auto it = baseline.find(keyOf(row.c));
+        if (it == baseline.end() || it->second <= 0) continue;
+        const double ratio = row.r.seconds / it->second;
+        if (ratio > 1 + tolerance) {
+            ++regressions;
+            std::cout << "REGRESSION " << keyOf(row.c) << ": " << std::fixed << std::setprecision(4)
+                      << it->second << " s -> " << row.r.seconds << " s (+" << std::setprecision(0)
+                      << (ratio - 1) * 100 << "%)\n";
+            std::cout.unsetf(std::ios::fixed);
+        }
+    }
+    if (!regressions) std::cout << "No regressions against " << path << "\n";
+    return regressions ? 2 : 0;
+}
+
+// ---------- Командная строка ----------
+
+std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream ss(text);
+    for (std::string item; std::getline(ss, item, ',');)
+        if (!item.empty()) items.push_back(item);
+    return items;
+}
+
+// 500K, 4M — число элементов, десятичные суффиксы
+size_t parseCount(const std::string& text) {
+    char* end = nullptr;
+    const double value = std::strtod(text.c_str(), &end);
+    const std::string suffix = end;
+    const double scale = suffix == "K" || suffix == "k" ? 1e3 : suffix == "M" || suffix == "m" ? 1e6 : 1;
+    return static_cast<size_t>(value * scale);
+}
+
+void printUsage(const char* name) {
+    std::cerr << "Usage: " << name << " [--sizes 1M,4M] [--threads 1,2,4] [--data uniform,...,strings]"
+              << " [--algos quick,...,external] [--reps 3] [--csv file] [--json file]"
+              << " [--baseline file.csv] [--tolerance 0.10] [--tmp dir]\n"
+              << "datasets: uniform sorted reverse few-unique zipf strings\n"
+              << "algorithms: quick parallel-quick merge radix string-msd std-sort std-stable-sort external\n";
+}
+
+int main(int argc, char** argv) {
+    const size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> sizes = {1'000'000};
+    std::vector<size_t> threadCounts = {1};
+    if (hardware > 1) threadCounts.push_back(hardware);
+    std::vector<std::string> datasets = ALL_DATASETS, algos = ALL_ALGOS;
+    std::string csvPath, jsonPath, baselinePath;
+    double tolerance = 0.10;
+    Options options;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string flag = argv[i];
+        if (i + 1 >= argc) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        const std::string value = argv[++i];
+        if (flag == "--sizes") {
+            sizes.clear();
+            for (const auto& s : splitList(value)) sizes.push_back(parseCount(s));
+        } else if (flag == "--threads") {
+            threadCounts.clear();
+            for (const auto& s : splitList(value)) threadCounts.push_back(std::max<size_t>(1, parseCount(s)));
+        } else if (flag == "--data") datasets = splitList(value);
+        else if (flag == "--algos") algos = splitList(value);
+        else if (flag == "--reps") options.reps = std::max(1, std::atoi(value.c_str()));
+        else if (flag == "--csv") csvPath = value;
+        else if (flag == "--json") jsonPath = value;
+        else if (flag == "--baseline") baselinePath = value;
+        else if (flag == "--tolerance") tolerance = std::atof(value.c_str());
+        else if (flag == "--tmp") options.tmpDir = value;
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    for (const auto& d : datasets)
+        if (std::find(ALL_DATASETS.begin(), ALL_DATASETS.end(), d) == ALL_DATASETS.end()) {
+            std::cerr << "Unknown dataset " << d << "\n";
+            return 1;
+        }
+    for (const auto& a : algos)
+        if (std::find(ALL_ALGOS.begin(), ALL_ALGOS.end(), a) == ALL_ALGOS.end()) {
+            std::cerr << "Unknown algorithm " << a << "\n";
+            return 1;
+        }
+
+    std::cout << "seed " << SEED << ", reps " << options.reps << ", hardware threads " << hardware << "\n"
+              << std::left << std::setw(16) << "algorithm" << std::setw(12) << "dataset" << std::right
+              << std::setw(10) << "elements" << std::setw(8) << "threads" << std::setw(11) << "seconds"
+              << std::setw(13) << "Melem/s" << std::setw(10) << "MB/s" << std::setw(12) << "peak MB"
+              << std::setw(11) << "scaling" << "\n";
+
+    std::vector<Row> rows;
+    bool allSorted = true;
+    for (size_t n : sizes)
+        for (const auto& dataset : datasets)
+            for (const auto& algo : algos) {
+                if (!applies(algo, dataset)) continue;
+                const std::vector<size_t> counts = isParallel(algo) ? threadCounts : std::vector<size_t>{1};
+                double single = 0;
+                for (size_t threads : counts) {
+                    Row row{{algo, dataset, n, threads}, {}};
+                    if (!runIsolated(row.c, options, row.r)) {
+                        std::cerr << "Case failed: " << keyOf(row.c) << "\n";
+                        allSorted = false;
+                        continue;
+                    }
+                    if (threads == 1) single = row.r.seconds;
+                    if (isParallel(algo) && single > 0)
+                        row.efficiency = single / (static_cast<double>(threads) * row.r.seconds);
+                    allSorted = allSorted && row.r.sorted;
+
+                    std::cout << std::left << std::setw(16) << algo << std::setw(12) << dataset << std::right
+                              << std::setw(10) << n << std::setw(8) << threads << std::fixed
+                              << std::setprecision(4) << std::setw(11) << row.r.seconds << std::setprecision(2)
+                              << std::setw(13) << n / row.r.seconds / 1e6 << std::setw(10)
+                              << row.r.bytes / 1e6 / row.r.seconds << std::setw(12) << row.r.peakKb / 1024.0;
+                    if (row.efficiency >= 0) std::cout << std::setw(11) << row.efficiency;
+                    std::cout << (row.r.sorted ? "" : "  NOT SORTED") << "\n";
+                    std::cout.unsetf(std::ios::fixed);
+                    rows.push_back(row);
+                }
+            }
+
+    if (!csvPath.empty()) {
+        std::ofstream out(csvPath);
+        writeCsv(out, rows);
+    }
+    if (!jsonPath.empty()) {
+        std::ofstream out(jsonPath);
+        writeJson(out, rows, options);
+    }
+    if (!allSorted) return 1;
+    return baselinePath.empty() ? 0 : compareBaseline(baselinePath, rows, tolerance);
+}
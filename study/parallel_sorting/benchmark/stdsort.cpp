@@ -5,30 +5,25 @@
 #include <algorithm>
 #include <iomanip>
 #include <limits>
+#include <string_view>
 #include <type_traits>
 
+#include "../src/include/MappedInput.hpp"
+
 template<typename T, typename SortFn>
 void process(const std::string& inputFile, const std::string& outputFile, SortFn sorter) {
-    std::ifstream in(inputFile);
-    if (!in) {
+    MappedInput input;
+    if (!input.open(inputFile)) {
         std::cerr << "Error opening " << inputFile << "\n";
         return;
     }
 
     std::vector<T> data;
-    if constexpr (std::is_same_v<T, std::string>) {
-        std::string line;
-        while (std::getline(in, line)) {
-            if (!line.empty())
-                data.push_back(line);
-        }
+    if constexpr (std::is_same_v<T, std::string_view>) {
+        data = input.lines(0);
     } else {
-        T x;
-        while (in >> x) {
-            data.push_back(x);
-        }
+        data = input.values<T>();
     }
-    in.close();
 
     sorter(data.begin(), data.end());
 
@@ -90,11 +85,11 @@ int main(int argc, char** argv) {
         }
     } else if (type == "-s") {
         if (stable) {
-            process<std::string>(inputFile, outputFile, [](auto begin, auto end) {
+            process<std::string_view>(inputFile, outputFile, [](auto begin, auto end) {
                 std::stable_sort(begin, end);
             });
         } else {
-            process<std::string>(inputFile, outputFile, [](auto begin, auto end) {
+            process<std::string_view>(inputFile, outputFile, [](auto begin, auto end) {
                 std::sort(begin, end);
             });
         }
@@ -1,11 +1,12 @@
 
 #include "include/ThreadPool.hpp"
+#include "include/Profiler.hpp"
 
 ThreadPool::ThreadPool(size_t numThreads) {
     for (size_t i = 0; i < numThreads; ++i)
         workers.emplace_back([this] {
             while (true) {
-                std::function<void()> task;
+                QueuedTask task;
 
                 {
                     std::unique_lock<std::mutex> lock(this->queueMutex);
@@ -19,7 +20,11 @@ ThreadPool::ThreadPool(size_t numThreads) {
                     this->tasks.pop();
                 }
 
-                task();
+                const std::uint64_t started = profiler::now();
+                profiler::add(Counter::PoolQueueWaitNanos, started - task.enqueuedAt);
+                profiler::add(Counter::PoolTasks, 1);
+                task.run();
+                profiler::record("pool.task", started);
             }
         });
 }
@@ -29,7 +34,7 @@ void ThreadPool::enqueue(std::function<void()> task) {
         std::lock_guard<std::mutex> lock(queueMutex);
         if (stop)
             throw std::runtime_error("enqueue on stopped ThreadPool");
-        tasks.emplace(std::move(task));
+        tasks.push({std::move(task), profiler::now()});
     }
     condition.notify_one();
 }
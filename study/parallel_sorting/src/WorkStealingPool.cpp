@@ -0,0 +1,259 @@
+#include "include/WorkStealingPool.hpp"
+
+thread_local WorkStealingPool* WorkStealingPool::currentPool = nullptr;
+thread_local WorkStealingPool::Worker* WorkStealingPool::currentWorker = nullptr;
+
+// ---------- Deque ----------
+
+WorkStealingPool::Deque::Deque() {
+    arrays.push_back(std::make_unique<Array>(256));
+    array.store(arrays.back().get(), std::memory_order_relaxed);
+}
+
+WorkStealingPool::Deque::Array* WorkStealingPool::Deque::grow(Array* old, int64_t t, int64_t b) {
+    arrays.push_back(std::make_unique<Array>(old->capacity * 2));
+    Array* bigger = arrays.back().get();
+    for (int64_t i = t; i < b; ++i)
+        bigger->put(i, old->get(i));
+    array.store(bigger, std::memory_order_release);
+    return bigger;
+}
+
+void WorkStealingPool::Deque::push(Job* job) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    Array* a = array.load(std::memory_order_relaxed);
+    if (b - t > a->capacity - 1)
+        a = grow(a, t, b);
+    a->put(b, job);
+    // release-запись вместо release-барьера: на x86 то же самое, а
+    // ThreadSanitizer видит публикацию задачи
+    bottom.store(b + 1, std::memory_order_release);
+}
+
+WorkStealingPool::Job* WorkStealingPool::Deque::pop() {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Array* a = array.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    Job* job = nullptr;
+    if (t <= b) {
+        job = a->get(b);
+        if (t == b) {
+            // Последний элемент: состязаемся с ворами
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                             std::memory_order_relaxed))
+                job = nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+    } else {
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+WorkStealingPool::Job* WorkStealingPool::Deque::steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return nullptr;
+
+    Array* a = array.load(std::memory_order_acquire);
+    Job* job = a->get(t);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed))
+        return nullptr;
+    return job;
+}
+
+// ---------- WorkStealingPool ----------
+
+WorkStealingPool::WorkStealingPool(size_t numThreads) {
+    if (numThreads == 0) numThreads = 1;
+    for (size_t i = 0; i < numThreads; ++i)
+        workers.push_back(std::make_unique<Worker>());
+    for (size_t i = 0; i < numThreads; ++i)
+        workers[i]->thread = std::thread([this, i] { workerLoop(i); });
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    stop.store(true, std::memory_order_release);
+    epoch.fetch_add(1, std::memory_order_release);
+    epoch.notify_all();
+    for (auto& worker : workers)
+        worker->thread.join();
+
+    for (Job* job : injection)
+        delete job;
+    for (auto& worker : workers) {
+        while (Job* job = worker->deque.pop())
+            delete job;
+        while (Job* job = worker->freeList) {
+            worker->freeList = job->nextFree;
+            delete job;
+        }
+    }
+}
+
+WorkStealingPool::Job* WorkStealingPool::allocateJob() {
+    if (currentPool == this && currentWorker->freeList) {
+        Job* job = currentWorker->freeList;
+        currentWorker->freeList = job->nextFree;
+        return job;
+    }
+    return new Job();
+}
+
+void WorkStealingPool::releaseJob(Job* job) {
+    job->task.reset();
+    if (currentPool == this) {
+        job->nextFree = currentWorker->freeList;
+        currentWorker->freeList = job;
+    } else {
+        delete job;
+    }
+}
+
+void WorkStealingPool::schedule(Job* job) {
+    if (currentPool == this) {
+        currentWorker->deque.push(job);
+    } else {
+        std::lock_guard<std::mutex> lock(injectionMutex);
+        injection.push_back(job);
+        injected.fetch_add(1, std::memory_order_release);
+    }
+    epoch.fetch_add(1, std::memory_order_release);
+    if (sleepers.load(std::memory_order_seq_cst) > 0)
+        epoch.notify_one();
+}
+
+void WorkStealingPool::execute(Job* job) {
+    Group* group = job->group;
+    std::exception_ptr failure;
+    try {
+        job->task();
+    } catch (...) {
+        if (!group) std::terminate();   // задаче без группы некуда отдать исключение
+        failure = std::current_exception();
+    }
+    releaseJob(job);
+    if (group) {
+        if (failure && !group->failed.exchange(true, std::memory_order_relaxed))
+            group->error = failure;
+        // После fetch_sub группа больше не трогается: ждущий может увидеть
+        // ноль, вернуться и разрушить её до notify
+        const size_t before = group->pending.fetch_sub(1, std::memory_order_acq_rel);
+        if (before == (Group::BLOCKING | 1)) {
+            released.fetch_add(1, std::memory_order_release);
+            released.notify_all();
+        }
+    }
+}
+
+WorkStealingPool::Job* WorkStealingPool::findJob(Worker* self) {
+    if (self) {
+        if (Job* job = self->deque.pop())
+            return job;
+    }
+
+    if (injected.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(injectionMutex);
+        if (!injection.empty()) {
+            Job* job = injection.front();
+            injection.pop_front();
+            injected.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    // Обходим чужие деки, начиная со следующего воркера, чтобы воры расходились
+    const size_t n = workers.size();
+    size_t start = 0;
+    if (self) {
+        for (size_t i = 0; i < n; ++i)
+            if (workers[i].get() == self) start = i + 1;
+    }
+    for (size_t k = 0; k < n; ++k) {
+        Worker* victim = workers[(start + k) % n].get();
+        if (victim == self) continue;
+        if (Job* job = victim->deque.steal())
+            return job;
+    }
+    return nullptr;
+}
+
+void WorkStealingPool::workerLoop(size_t index) {
+    currentPool = this;
+    currentWorker = workers[index].get();
+
+    while (true) {
+        uint64_t seen = epoch.load(std::memory_order_acquire);
+        if (Job* job = findJob(currentWorker)) {
+            execute(job);
+            continue;
+        }
+        if (stop.load(std::memory_order_acquire))
+            break;
+
+        // Немного покрутиться перед сном: задачи fork/join приходят пачками
+        bool found = false;
+        for (int spin = 0; spin < 64 && !found; ++spin) {
+            std::this_thread::yield();
+            if (Job* job = findJob(currentWorker)) {
+                execute(job);
+                found = true;
+            }
+        }
+        if (found)
+            continue;
+
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        if (epoch.load(std::memory_order_seq_cst) == seen && !stop.load(std::memory_order_acquire))
+            epoch.wait(seen, std::memory_order_acquire);
+        sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    currentPool = nullptr;
+    currentWorker = nullptr;
+}
+
+void WorkStealingPool::wait(Group& group) {
+    if (currentPool != this) {
+        // Сторонний поток только ждёт: его задачи порождались бы в очередь
+        // инъекции, и вложенные wait() разворачивали бы её на его стеке
+        // released читается до проверки счётчика: если последний fetch_sub
+        // случился после проверки, его fetch_add сменит released и wait вернётся
+        group.pending.fetch_or(Group::BLOCKING, std::memory_order_acq_rel);
+        while (true) {
+            const uint32_t seen = released.load(std::memory_order_acquire);
+            if (group.pending.load(std::memory_order_acquire) == Group::BLOCKING)
+                break;
+            released.wait(seen, std::memory_order_acquire);
+        }
+        group.pending.fetch_and(~Group::BLOCKING, std::memory_order_relaxed);
+        rethrowFailure(group);
+        return;
+    }
+
+    // Воркер не засыпает, а выполняет работу: сначала свою (LIFO — вложенность
+    // стека ограничена глубиной рекурсии), затем чужую
+    while (!group.done()) {
+        if (Job* job = findJob(currentWorker))
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+    rethrowFailure(group);
+}
+
+// Группу можно ждать повторно: исключение отдаётся один раз
+void WorkStealingPool::rethrowFailure(Group& group) {
+    if (!group.failed.load(std::memory_order_relaxed))
+        return;
+    std::exception_ptr failure = std::exchange(group.error, nullptr);
+    group.failed.store(false, std::memory_order_relaxed);
+    std::rethrow_exception(failure);
+}
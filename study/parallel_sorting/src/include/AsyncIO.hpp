@@ -0,0 +1,404 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define PSORT_HAVE_IO_URING 1
+#else
+#define PSORT_HAVE_IO_URING 0
+#endif
+
+
+// ---------- Асинхронный ввод-вывод ----------
+//
+// AsyncIO принимает запросы pread/pwrite и выполняет их в фоне, пока
+// вызывающий поток продолжает считать: слияние читает следующий блок каждого
+// рана заранее (RunReader), запись ранов и итогового файла уходит из
+// буфера, пока заполняется второй (OutputWriter).
+//
+// Бэкенд — io_uring через сырые системные вызовы (без liburing), если ядро
+// поддерживает его операции чтения и записи (5.6+), иначе несколько потоков
+// ввода-вывода с pread/pwrite.
+// depth — сколько запросов одновременно в полёте; когда все места заняты,
+// read/write возвращают NO_TICKET, и вызывающий делает операцию синхронно.
+// depth == 0 — асинхронности нет вовсе.
+//
+// Экземпляр не потокобезопасен: запросы подаёт и ждёт один поток (или
+// несколько по очереди, с синхронизацией между ними). Буфер запроса должен
+// жить до wait().
+//
+// Время, которое потоки провели в ожидании ввода-вывода (wait() и
+// синхронные pread/pwrite читателей и писателей), копится в ioStats().
+
+struct IOStats {
+    std::atomic<std::uint64_t> waitNanos{0};
+    std::atomic<std::uint64_t> bytesRead{0};
+    std::atomic<std::uint64_t> bytesWritten{0};
+};
+
+inline IOStats& ioStats() {
+    static IOStats stats;
+    return stats;
+}
+
+// Засекает ожидание ввода-вывода от создания до разрушения
+class IOWaitTimer {
+public:
+    IOWaitTimer() : start_(std::chrono::steady_clock::now()) {}
+    ~IOWaitTimer() {
+        const auto elapsed = std::chrono::steady_clock::now() - start_;
+        ioStats().waitNanos += static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+    IOWaitTimer(const IOWaitTimer&) = delete;
+    IOWaitTimer& operator=(const IOWaitTimer&) = delete;
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+namespace async_io_detail {
+
+// pread/pwrite до конца или ошибки; результат — байты или -errno
+inline long transfer(bool write, int fd, char* buf, size_t bytes, std::uint64_t offset) {
+    size_t done = 0;
+    while (done < bytes) {
+        const ssize_t n = write ? ::pwrite(fd, buf + done, bytes - done, static_cast<off_t>(offset + done))
+                                : ::pread(fd, buf + done, bytes - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return done > 0 ? static_cast<long>(done) : -errno;
+        if (n == 0) break;   // конец файла при чтении
+        done += static_cast<size_t>(n);
+    }
+    return static_cast<long>(done);
+}
+
+inline void countBytes(bool write, long result) {
+    if (result <= 0) return;
+    (write ? ioStats().bytesWritten : ioStats().bytesRead) += static_cast<std::uint64_t>(result);
+}
+
+}  // namespace async_io_detail
+
+
+class AsyncIO {
+public:
+    enum class Backend { Sync, Uring, Threads };
+
+    using Ticket = size_t;
+    static constexpr Ticket NO_TICKET = static_cast<Ticket>(-1);
+
+    static constexpr unsigned DEFAULT_DEPTH = 32;
+    static constexpr unsigned MAX_IO_THREADS = 4;
+
+    explicit AsyncIO(unsigned depth = DEFAULT_DEPTH, Backend preferred = Backend::Uring)
+        : slots_(depth) {
+        for (size_t i = depth; i > 0; --i) free_.push_back(i - 1);
+        if (depth == 0) return;
+        if (preferred == Backend::Uring && setupUring(depth)) {
+            backend_ = Backend::Uring;
+            return;
+        }
+        backend_ = Backend::Threads;
+        const unsigned threads = std::min(depth, MAX_IO_THREADS);
+        for (unsigned i = 0; i < threads; ++i) workers_.emplace_back([this] { workerLoop(); });
+    }
+
+    ~AsyncIO() {
+        // Запросы в полёте пишут в чужие буферы — дожидаемся их
+        for (size_t i = 0; i < slots_.size(); ++i)
+            if (slots_[i].busy) wait(i);
+        if (backend_ == Backend::Threads) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            queued_.notify_all();
+            for (auto& w : workers_) w.join();
+        }
+        closeUring();
+    }
+
+    AsyncIO(const AsyncIO&) = delete;
+    AsyncIO& operator=(const AsyncIO&) = delete;
+
+    bool enabled() const { return backend_ != Backend::Sync; }
+    Backend backend() const { return backend_; }
+    unsigned depth() const { return static_cast<unsigned>(slots_.size()); }
+
+    Ticket read(int fd, void* buf, size_t bytes, std::uint64_t offset) {
+        return submit(false, fd, static_cast<char*>(buf), bytes, offset);
+    }
+
+    Ticket write(int fd, const void* buf, size_t bytes, std::uint64_t offset) {
+        return submit(true, fd, static_cast<char*>(const_cast<void*>(buf)), bytes, offset);
+    }
+
+    // Ждёт запрос; результат — число байт (меньше запрошенного только в
+    // конце файла) или -errno. Каждый билет ждут ровно один раз
+    long wait(Ticket ticket) {
+        Slot& slot = slots_[ticket];
+        if (backend_ == Backend::Uring) {
+            if (slot.state != Slot::Done) {
+                IOWaitTimer timer;
+                while (slot.state != Slot::Done) reapUring(true);
+            }
+        } else {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (slot.state != Slot::Done) {
+                IOWaitTimer timer;
+                completed_.wait(lock, [&slot] { return slot.state == Slot::Done; });
+            }
+        }
+        long result = slot.result;
+        // Ядро может вернуть меньше запрошенного — дочитываем/дописываем сами
+        if (result >= 0 && static_cast<size_t>(result) < slot.bytes && !(result == 0 && !slot.write)) {
+            IOWaitTimer timer;
+            const long rest = async_io_detail::transfer(slot.write, slot.fd, slot.buf + result,
+                                                        slot.bytes - static_cast<size_t>(result),
+                                                        slot.offset + static_cast<std::uint64_t>(result));
+            async_io_detail::countBytes(slot.write, rest);
+            result = rest < 0 ? rest : result + rest;
+        }
+        slot.busy = false;
+        free_.push_back(ticket);
+        return result;
+    }
+
+    // Бэкенд, который получит AsyncIO(depth), — для отчёта
+    static const char* describe(unsigned depth) {
+        if (depth == 0) return "синхронно";
+        return uringAvailable() ? "io_uring" : "потоки ввода-вывода";
+    }
+
+private:
+    // busy меняет только владелец; state после подачи — поток ввода-вывода
+    // (под mutex_) или reapUring
+    struct Slot {
+        enum State { InFlight, Done };
+        bool busy = false;
+        State state = Done;
+        bool write = false;
+        int fd = -1;
+        char* buf = nullptr;
+        size_t bytes = 0;
+        std::uint64_t offset = 0;
+        long result = 0;
+    };
+
+    Ticket submit(bool write, int fd, char* buf, size_t bytes, std::uint64_t offset) {
+        if (!enabled()) return NO_TICKET;
+        if (free_.empty()) return NO_TICKET;
+        const Ticket ticket = free_.back();
+        free_.pop_back();
+        Slot& slot = slots_[ticket];
+        slot = Slot{true, Slot::InFlight, write, fd, buf, bytes, offset, 0};
+        if (backend_ == Backend::Uring) {
+            if (!submitUring(ticket)) {
+                // Кольцо отказало — выполняем на месте, билет уже готов
+                slot.result = async_io_detail::transfer(write, fd, buf, bytes, offset);
+                async_io_detail::countBytes(write, slot.result);
+                slot.state = Slot::Done;
+            }
+        } else {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                queue_.push_back(ticket);
+            }
+            queued_.notify_one();
+        }
+        return ticket;
+    }
+
+    // ---------- Потоки ввода-вывода ----------
+
+    void workerLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            queued_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            const Ticket ticket = queue_.front();
+            queue_.pop_front();
+            Slot request = slots_[ticket];
+            lock.unlock();
+            const long result = async_io_detail::transfer(request.write, request.fd, request.buf,
+                                                          request.bytes, request.offset);
+            async_io_detail::countBytes(request.write, result);
+            lock.lock();
+            slots_[ticket].result = result;
+            slots_[ticket].state = Slot::Done;
+            completed_.notify_all();
+        }
+    }
+
+    // ---------- io_uring ----------
+
+#if PSORT_HAVE_IO_URING
+    // Кольцо создаётся с ядра 5.1, а IORING_OP_READ/WRITE появились только в
+    // 5.6: на промежуточных ядрах каждый запрос вернул бы -EINVAL. Поэтому
+    // кроме io_uring_setup нужен IORING_REGISTER_PROBE (он тоже из 5.6) с
+    // обеими операциями в списке поддерживаемых
+    static bool uringAvailable() {
+        static const bool available = [] {
+            io_uring_params params{};
+            const int fd = static_cast<int>(::syscall(__NR_io_uring_setup, 1, &params));
+            if (fd < 0) return false;
+            constexpr unsigned OPS = 256;
+            std::vector<char> storage(sizeof(io_uring_probe) + OPS * sizeof(io_uring_probe_op), 0);
+            auto* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+            const bool probed = ::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, OPS) == 0;
+            ::close(fd);
+            auto supported = [probe](unsigned op) {
+                return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+            };
+            return probed && supported(IORING_OP_READ) && supported(IORING_OP_WRITE);
+        }();
+        return available;
+    }
+
+    bool setupUring(unsigned depth) {
+        if (!uringAvailable()) return false;
+        io_uring_params params{};
+        ringFd_ = static_cast<int>(::syscall(__NR_io_uring_setup, depth, &params));
+        if (ringFd_ < 0) return false;
+
+        sqRingBytes_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingBytes_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqRingBytes_ = cqRingBytes_ = std::max(sqRingBytes_, cqRingBytes_);
+
+        sqRing_ = ::mmap(nullptr, sqRingBytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ringFd_, IORING_OFF_SQ_RING);
+        if (sqRing_ == MAP_FAILED) { sqRing_ = nullptr; closeUring(); return false; }
+        cqRing_ = single ? sqRing_
+                         : ::mmap(nullptr, cqRingBytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                  ringFd_, IORING_OFF_CQ_RING);
+        if (cqRing_ == MAP_FAILED) { cqRing_ = nullptr; closeUring(); return false; }
+        sqesBytes_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, sqesBytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ringFd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) { closeUring(); return false; }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq = static_cast<char*>(sqRing_);
+        char* cq = static_cast<char*>(cqRing_);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    void closeUring() {
+        if (sqes_) ::munmap(sqes_, sqesBytes_);
+        if (cqRing_ && cqRing_ != sqRing_) ::munmap(cqRing_, cqRingBytes_);
+        if (sqRing_) ::munmap(sqRing_, sqRingBytes_);
+        if (ringFd_ >= 0) ::close(ringFd_);
+        sqes_ = nullptr;
+        sqRing_ = cqRing_ = nullptr;
+        ringFd_ = -1;
+    }
+
+    // Запросов в полёте не больше depth, поэтому место в SQ и CQ всегда есть
+    bool submitUring(Ticket ticket) {
+        const Slot& slot = slots_[ticket];
+        const unsigned tail = *sqTail_;
+        const unsigned index = tail & sqMask_;
+        io_uring_sqe& sqe = sqes_[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = slot.write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe.fd = slot.fd;
+        sqe.addr = reinterpret_cast<std::uint64_t>(slot.buf);
+        sqe.len = static_cast<unsigned>(std::min<size_t>(slot.bytes, 1u << 30));
+        sqe.off = slot.offset;
+        sqe.user_data = ticket;
+        sqArray_[index] = index;
+        std::atomic_ref<unsigned>(*sqTail_).store(tail + 1, std::memory_order_release);
+
+        long submitted;
+        do {
+            submitted = ::syscall(__NR_io_uring_enter, ringFd_, 1, 0, 0, nullptr, 0);
+        } while (submitted < 0 && errno == EINTR);
+        if (submitted == 1) return true;
+        // Ядро не забрало запрос — откатываем хвост
+        std::atomic_ref<unsigned>(*sqTail_).store(tail, std::memory_order_release);
+        return false;
+    }
+
+    // Забирает готовые завершения; block — ждать хотя бы одно
+    void reapUring(bool block) {
+        unsigned head = *cqHead_;
+        unsigned tail = std::atomic_ref<unsigned>(*cqTail_).load(std::memory_order_acquire);
+        if (head == tail && block) {
+            long entered;
+            do {
+                entered = ::syscall(__NR_io_uring_enter, ringFd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            } while (entered < 0 && errno == EINTR);
+            tail = std::atomic_ref<unsigned>(*cqTail_).load(std::memory_order_acquire);
+        }
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes_[head & cqMask_];
+            Slot& slot = slots_[static_cast<Ticket>(cqe.user_data)];
+            slot.result = cqe.res;
+            slot.state = Slot::Done;
+            async_io_detail::countBytes(slot.write, cqe.res);
+        }
+        std::atomic_ref<unsigned>(*cqHead_).store(head, std::memory_order_release);
+    }
+#else
+    static bool uringAvailable() { return false; }
+    bool setupUring(unsigned) { return false; }
+    void closeUring() {}
+    bool submitUring(Ticket) { return false; }
+    void reapUring(bool) {}
+#endif
+
+    std::vector<Slot> slots_;
+    std::vector<Ticket> free_;
+    Backend backend_ = Backend::Sync;
+
+    // Потоки ввода-вывода
+    std::vector<std::thread> workers_;
+    std::deque<Ticket> queue_;
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable completed_;
+    bool stop_ = false;
+
+#if PSORT_HAVE_IO_URING
+    int ringFd_ = -1;
+    void* sqRing_ = nullptr;
+    void* cqRing_ = nullptr;
+    size_t sqRingBytes_ = 0;
+    size_t cqRingBytes_ = 0;
+    size_t sqesBytes_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+#endif
+};
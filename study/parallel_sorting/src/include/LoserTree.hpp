@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// Дерево проигравших для k-путевого слияния.
+// Листья — номера источников 0..k-1, во внутренних узлах хранится проигравший
+// в матче, в корне — общий победитель. После того как победитель выдал
+// значение и продвинулся, replay() переигрывает только путь от его листа до
+// корня: одно сравнение на уровень, log2(k) сравнений на выходной элемент.
+//
+// Текущие значения источников лежат снаружи, в heads (голова источника i —
+// heads[i], alive[i] == 0 — источник исчерпан и проигрывает всем). Узел
+// хранит ключ проигравшего прямо в себе (для чисел — значение, для тяжёлых
+// типов — указатель на heads[i]), поэтому переигровка не ходит за ключами по
+// индексам. При равных значениях выигрывает источник с меньшим номером, так
+// что слияние детерминировано и устойчиво по номерам ранов.
+//
+// Числа до 32 бит в порядке less/greater упаковываются в одно 64-битное
+// слово: старшие биты — ключ в порядке беззнакового сравнения, младшие —
+// номер источника, исчерпанный источник — все единицы. Матч тогда — одно
+// сравнение слов, а переигровка — min/max без ветвлений: на случайных
+// ключах ветви матчей не предсказываются, и для int с ними дерево было
+// медленнее кучи.
+template<typename T, typename Compare>
+class LoserTree {
+    static constexpr bool PACKED =
+        std::is_arithmetic_v<T> && sizeof(T) <= 4 &&
+        (std::is_same_v<Compare, std::less<T>> || std::is_same_v<Compare, std::greater<T>>);
+
+    using Key = std::conditional_t<std::is_arithmetic_v<T>, T, const T*>;
+
+    struct Node {
+        Key key;
+        std::uint32_t source;
+        std::uint32_t dead;
+    };
+
+public:
+    LoserTree(const std::vector<T>& heads, const std::vector<char>& alive, Compare comp)
+        : k(heads.size()), tree(PACKED ? 0 : (k ? k : 1)), heads(heads), alive(alive), comp(comp) {
+        if (k == 0) return;
+        if constexpr (PACKED) {
+            packed.resize(k);
+            std::vector<std::uint64_t> winners(2 * k);
+            for (size_t i = 0; i < k; ++i)
+                winners[k + i] = packedLeaf(i);
+            for (size_t n = k - 1; n >= 1; --n) {
+                winners[n] = std::min(winners[2 * n], winners[2 * n + 1]);
+                packed[n] = std::max(winners[2 * n], winners[2 * n + 1]);
+            }
+            packedTop = winners[1];
+            return;
+        }
+        // Строим снизу вверх: узел n — матч победителей узлов 2n и 2n + 1,
+        // листья занимают номера k..2k-1
+        std::vector<Node> winners(2 * k);
+        for (size_t i = 0; i < k; ++i)
+            winners[k + i] = leaf(i);
+        for (size_t n = k - 1; n >= 1; --n) {
+            Node a = winners[2 * n], b = winners[2 * n + 1];
+            if (beats(b, a)) std::swap(a, b);
+            winners[n] = a;
+            tree[n] = b;
+        }
+        top = winners[1];   // при k == 1 это единственный лист
+    }
+
+    size_t size() const { return k; }
+
+    bool empty() const {
+        if constexpr (PACKED) return k == 0 || packedTop == DEAD;
+        else return k == 0 || top.dead;
+    }
+
+    // Источник, чьё текущее значение идёт следующим
+    size_t winner() const {
+        if constexpr (PACKED) return static_cast<std::uint32_t>(packedTop);
+        else return top.source;
+    }
+
+    // Вызывается после того, как источник winner() продвинулся
+    void replay() {
+        if constexpr (PACKED) {
+            const size_t source = static_cast<std::uint32_t>(packedTop);
+            std::uint64_t w = packedLeaf(source);
+            std::uint64_t* nodes = packed.data();
+            for (size_t n = (source + k) / 2; n >= 1; n /= 2) {
+                const std::uint64_t node = nodes[n];
+                nodes[n] = std::max(node, w);
+                w = std::min(node, w);
+            }
+            packedTop = w;
+            return;
+        }
+        const size_t source = top.source;
+        Node w = leaf(source);
+        Node* nodes = tree.data();
+        for (size_t n = (source + k) / 2; n >= 1; n /= 2) {
+            if (beats(nodes[n], w))
+                std::swap(nodes[n], w);
+        }
+        top = w;
+    }
+
+private:
+    static constexpr std::uint64_t DEAD = ~std::uint64_t{0};
+
+    // Ключ в порядке беззнакового сравнения; -0.0 и 0.0 равны, как для comp
+    static std::uint32_t orderedKey(T value) {
+        std::uint32_t key;
+        if constexpr (std::is_floating_point_v<T>) {
+            const float f = value == 0 ? 0.0f : static_cast<float>(value);
+            std::memcpy(&key, &f, sizeof(key));
+            key = (key & 0x80000000u) ? ~key : (key | 0x80000000u);
+        } else if constexpr (std::is_signed_v<T>) {
+            key = static_cast<std::uint32_t>(static_cast<std::int32_t>(value)) ^ 0x80000000u;
+        } else {
+            key = static_cast<std::uint32_t>(value);
+        }
+        if constexpr (std::is_same_v<Compare, std::greater<T>>) key = ~key;
+        return key;
+    }
+
+    std::uint64_t packedLeaf(size_t i) const {
+        return alive[i] ? (std::uint64_t{orderedKey(heads[i])} << 32) | i : DEAD;
+    }
+
+    Node leaf(size_t i) const {
+        Key key;
+        if constexpr (std::is_arithmetic_v<T>) key = heads[i];
+        else key = &heads[i];
+        return {key, static_cast<std::uint32_t>(i), alive[i] ? 0u : 1u};
+    }
+
+    bool beats(const Node& a, const Node& b) const {
+        if (a.dead) return false;
+        if (b.dead) return true;
+        if constexpr (std::is_arithmetic_v<T>) {
+            // Второе сравнение нужно только при равенстве, ветви предсказуемы
+            return comp(a.key, b.key) || (a.source < b.source && !comp(b.key, a.key));
+        } else {
+            // Для тяжёлых ключей — ровно одно сравнение на матч
+            return a.source < b.source ? !comp(*b.key, *a.key) : comp(*a.key, *b.key);
+        }
+    }
+
+    size_t k;
+    std::vector<Node> tree;
+    Node top{};
+    std::vector<std::uint64_t> packed;   // узлы упакованного дерева
+    std::uint64_t packedTop = DEAD;
+    const std::vector<T>& heads;
+    const std::vector<char>& alive;
+    Compare comp;
+};
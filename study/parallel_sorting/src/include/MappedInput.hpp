@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// ---------- Чтение входа через mmap ----------
+//
+// Файл отображается в память целиком, разбор идёт прямо по отображению:
+// строки — string_view в него (без выделения памяти на строку), числа —
+// std::from_chars. Концы строк ищутся memchr (в glibc он векторный).
+//
+// Загрузка целиком (lines/values) режет файл на части по границам строк
+// или пробелов и разбирает части в нескольких потоках, результат склеивается
+// в исходном порядке. Потоковое чтение (InputCursor) идёт последовательно и
+// отдаёт ядру уже пройденные страницы, так что внешняя сортировка файла
+// больше памяти не держит его в резидентной памяти.
+//
+// Разбор чисел повторяет operator>>: значения разделены любыми пробельными
+// символами, допускается ведущий '+', на первом неразборчивом токене чтение
+// останавливается. Пустые строки пропускаются при любом способе чтения, так
+// что все режимы сортируют одни и те же строки.
+
+namespace mapped_input_detail {
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Разбирает одно число начиная с p; p сдвигается за него.
+// false — вход кончился или токен не является числом
+template<typename T>
+bool parseNumber(const char*& p, const char* end, T& value) {
+    while (p < end && isSpace(*p)) ++p;
+    if (p == end) return false;
+    const char* first = p;
+    if (*first == '+' && first + 1 < end && *(first + 1) != '-') ++first;
+    const auto [next, ec] = std::from_chars(first, end, value);
+    if (ec != std::errc()) return false;
+    p = next;
+    return true;
+}
+
+// Следующая непустая строка без '\n'; p сдвигается за перевод строки
+inline bool nextLine(const char*& p, const char* end, std::string_view& line) {
+    while (p < end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        const char* stop = newline ? newline : end;
+        line = std::string_view(p, static_cast<size_t>(stop - p));
+        p = newline ? newline + 1 : end;
+        if (!line.empty()) return true;
+    }
+    return false;
+}
+
+// Отдаёт ядру целые страницы отображения [base, base + bytes): они уже
+// прочитаны. Повторное обращение к ним перечитает файл, так что это безопасно
+inline void releasePages(const char* base, size_t bytes) {
+    const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    bytes = bytes / page * page;
+    if (base && bytes > 0) ::madvise(const_cast<char*>(base), bytes, MADV_DONTNEED);
+}
+
+}  // namespace mapped_input_detail
+
+
+class MappedInput {
+public:
+    // Меньше этого на поток файл не делится
+    static constexpr size_t MIN_PART_BYTES = 1 << 20;
+
+    MappedInput() = default;
+    explicit MappedInput(const std::string& path) { open(path); }
+    ~MappedInput() { close(); }
+
+    MappedInput(const MappedInput&) = delete;
+    MappedInput& operator=(const MappedInput&) = delete;
+
+    MappedInput(MappedInput&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)),
+          fd_(std::exchange(other.fd_, -1)) {}
+
+    MappedInput& operator=(MappedInput&& other) noexcept {
+        if (this != &other) {
+            close();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            fd_ = std::exchange(other.fd_, -1);
+        }
+        return *this;
+    }
+
+    bool open(const std::string& path) {
+        close();
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) return false;
+        struct stat st{};
+        if (::fstat(fd_, &st) != 0) {
+            close();
+            return false;
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (p == MAP_FAILED) {
+                close();
+                return false;
+            }
+            data_ = static_cast<const char*>(p);
+            ::madvise(p, size_, MADV_SEQUENTIAL);
+        }
+        return true;
+    }
+
+    void close() {
+        if (data_) ::munmap(const_cast<char*>(data_), size_);
+        if (fd_ >= 0) ::close(fd_);
+        data_ = nullptr;
+        size_ = 0;
+        fd_ = -1;
+    }
+
+    bool ok() const { return fd_ >= 0; }
+
+    std::string_view data() const { return {data_, size_}; }
+
+    size_t size() const { return size_; }
+
+    // Все непустые строки файла
+    std::vector<std::string_view> lines(size_t threads = 0) const {
+        auto parts = split(threads, [](char c) { return c == '\n'; });
+        std::vector<std::vector<std::string_view>> found(parts.size());
+        forEachPart(parts.size(), [&](size_t i) {
+            const char* p = data_ + parts[i].first;
+            const char* end = data_ + parts[i].second;
+            std::string_view line;
+            while (mapped_input_detail::nextLine(p, end, line)) found[i].push_back(line);
+        });
+        return concat(found, parts.size());
+    }
+
+    // Все числа файла до первого неразборчивого токена
+    template<typename T>
+    std::vector<T> values(size_t threads = 0) const {
+        static_assert(std::is_arithmetic_v<T>, "values<T>() разбирает только числа");
+        auto parts = split(threads, mapped_input_detail::isSpace);
+        std::vector<std::vector<T>> found(parts.size());
+        std::vector<char> stopped(parts.size(), 0);
+        forEachPart(parts.size(), [&](size_t i) {
+            const char* p = data_ + parts[i].first;
+            const char* end = data_ + parts[i].second;
+            found[i].reserve((parts[i].second - parts[i].first) / 8);
+            T value;
+            while (mapped_input_detail::parseNumber(p, end, value)) found[i].push_back(value);
+            while (p < end && mapped_input_detail::isSpace(*p)) ++p;
+            stopped[i] = p < end;
+        });
+        // Части после первой остановки отбрасываются, как у operator>>
+        size_t used = parts.size();
+        for (size_t i = 0; i < parts.size(); ++i)
+            if (stopped[i]) { used = i + 1; break; }
+        return concat(found, used);
+    }
+
+    // Обход непустых строк без сбора в массив: visit(part, line) вызывается в потоке
+    // части part (part < threads), внутри части — по порядку файла.
+    // threads == 0 — по числу ядер
+    template<typename Visit>
+    void forEachLine(size_t threads, Visit&& visit) const {
+        auto parts = split(threads, [](char c) { return c == '\n'; });
+        forEachPart(parts.size(), [&](size_t i) {
+            const char* p = data_ + parts[i].first;
+            const char* end = data_ + parts[i].second;
+            std::string_view line;
+            while (mapped_input_detail::nextLine(p, end, line)) visit(i, line);
+        });
+    }
+
+    // То же для чисел. Возвращает, сколько первых частей действительны:
+    // части после первого неразборчивого токена вызывающий отбрасывает сам,
+    // как это делает values()
+    template<typename T, typename Visit>
+    size_t forEachValue(size_t threads, Visit&& visit) const {
+        static_assert(std::is_arithmetic_v<T>, "forEachValue<T>() разбирает только числа");
+        auto parts = split(threads, mapped_input_detail::isSpace);
+        std::vector<char> stopped(parts.size(), 0);
+        forEachPart(parts.size(), [&](size_t i) {
+            const char* p = data_ + parts[i].first;
+            const char* end = data_ + parts[i].second;
+            T value;
+            while (mapped_input_detail::parseNumber(p, end, value)) visit(i, value);
+            while (p < end && mapped_input_detail::isSpace(*p)) ++p;
+            stopped[i] = p < end;
+        });
+        for (size_t i = 0; i < parts.size(); ++i)
+            if (stopped[i]) return i + 1;
+        return parts.size();
+    }
+
+private:
+    // Части [first, second) с границами сразу после символа-разделителя
+    template<typename IsBoundary>
+    std::vector<std::pair<size_t, size_t>> split(size_t threads, IsBoundary isBoundary) const {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        const size_t count = std::max<size_t>(1, std::min(threads, size_ / MIN_PART_BYTES));
+        std::vector<std::pair<size_t, size_t>> parts;
+        size_t begin = 0;
+        for (size_t i = 1; i <= count && begin < size_; ++i) {
+            size_t end = i == count ? size_ : std::max(begin, size_ / count * i);
+            while (end < size_ && !isBoundary(data_[end])) ++end;
+            if (end < size_) ++end;
+            parts.emplace_back(begin, end);
+            begin = end;
+        }
+        return parts;
+    }
+
+    template<typename Fn>
+    static void forEachPart(size_t count, Fn&& fn) {
+        if (count <= 1) {
+            if (count == 1) fn(0);
+            return;
+        }
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < count; ++i) workers.emplace_back([&fn, i] { fn(i); });
+        fn(0);
+        for (auto& w : workers) w.join();
+    }
+
+    template<typename V>
+    static std::vector<V> concat(std::vector<std::vector<V>>& found, size_t used) {
+        if (used == 1) return std::move(found[0]);
+        size_t total = 0;
+        for (size_t i = 0; i < used; ++i) total += found[i].size();
+        std::vector<V> all;
+        all.reserve(total);
+        for (size_t i = 0; i < used; ++i) {
+            all.insert(all.end(), found[i].begin(), found[i].end());
+            std::vector<V>().swap(found[i]);
+        }
+        return all;
+    }
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    int fd_ = -1;
+};
+
+
+// Последовательное чтение значений из отображения MappedInput. Каждые
+// RELEASE_STEP байт пройденная часть отображения отдаётся ядру. Курсор
+// хранит только указатели в отображение, поэтому переживает перемещение
+// MappedInput, но не его закрытие.
+class InputCursor {
+public:
+    static constexpr size_t RELEASE_STEP = 4 << 20;
+
+    InputCursor() = default;
+
+    explicit InputCursor(const MappedInput& input)
+        : begin_(input.data().data()), p_(begin_), end_(begin_ + input.size()) {}
+
+    // Число; для строк — следующая непустая строка
+    template<typename T>
+    bool next(T& value) {
+        bool ok;
+        if constexpr (std::is_arithmetic_v<T>) {
+            ok = mapped_input_detail::parseNumber(p_, end_, value);
+        } else {
+            std::string_view line;
+            ok = mapped_input_detail::nextLine(p_, end_, line);
+            if (ok) value.assign(line.data(), line.size());
+        }
+        maybeRelease();
+        return ok;
+    }
+
+    // Следующая непустая строка
+    bool nextLine(std::string_view& line) {
+        const bool ok = mapped_input_detail::nextLine(p_, end_, line);
+        maybeRelease();
+        return ok;
+    }
+
+private:
+    void maybeRelease() {
+        const size_t offset = static_cast<size_t>(p_ - begin_);
+        if (offset - released_ >= RELEASE_STEP) {
+            mapped_input_detail::releasePages(begin_, offset);
+            released_ = offset;
+        }
+    }
+
+    const char* begin_ = nullptr;
+    const char* p_ = nullptr;
+    const char* end_ = nullptr;
+    size_t released_ = 0;
+};
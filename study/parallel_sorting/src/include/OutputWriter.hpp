@@ -0,0 +1,310 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "AsyncIO.hpp"
+
+
+// ---------- Запись текстового вывода ----------
+//
+// Значения форматируются std::to_chars прямо в большой выровненный буфер,
+// без ostream и локалей; заполненный буфер уходит в файл одним pwrite.
+// Плавающая точка пишется кратчайшей записью, которая читается обратно в то
+// же самое значение: короче fixed с max_digits10 и без потери точности.
+// Строки копируются как есть.
+//
+// writeAll форматирует массив целиком: значения режутся на блоки по
+// OUTPUT_BLOCK_VALUES, блоки очередной волны форматируются в нескольких
+// потоках в свои буферы, по длинам блоков считаются смещения в файле, и
+// каждый поток пишет свой блок pwrite на его место. Порядок в файле исходный
+// независимо от того, какой поток закончил первым.
+//
+// С AsyncIO буферов два: заполненный уходит в асинхронную запись, а значения
+// пишутся во второй; перед следующим сбросом предыдущая запись дожидается.
+
+constexpr size_t DEFAULT_OUTPUT_BUFFER = 8 << 20;
+constexpr size_t OUTPUT_BLOCK_VALUES = 1 << 18;
+constexpr size_t OUTPUT_ALIGNMENT = 4096;
+
+namespace output_detail {
+
+// Самое длинное число до 8 байт с разделителем: "-2.2250738585072014e-308\n"
+constexpr size_t MAX_NUMBER_CHARS = 32;
+
+template<typename T>
+size_t maxChars(const T& value) {
+    if constexpr (std::is_arithmetic_v<T>) return MAX_NUMBER_CHARS;
+    else return std::string_view(value).size() + 1;
+}
+
+// Пишет value и sep начиная с p; места должно быть не меньше maxChars(value)
+template<typename T>
+char* format(char* p, char* end, const T& value, char sep) {
+    if constexpr (std::is_arithmetic_v<T>) {
+        p = std::to_chars(p, end, value).ptr;
+    } else {
+        const std::string_view s(value);
+        std::memcpy(p, s.data(), s.size());
+        p += s.size();
+    }
+    *p++ = sep;
+    return p;
+}
+
+inline bool pwriteAll(int fd, const char* data, size_t bytes, std::uint64_t offset) {
+    IOWaitTimer timer;
+    const long written = async_io_detail::transfer(true, fd, const_cast<char*>(data), bytes, offset);
+    async_io_detail::countBytes(true, written);
+    return written == static_cast<long>(bytes);
+}
+
+template<typename Fn>
+void forEachPart(size_t count, Fn&& fn) {
+    if (count <= 1) {
+        if (count == 1) fn(0);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < count; ++i) workers.emplace_back([&fn, i] { fn(i); });
+    fn(0);
+    for (auto& w : workers) w.join();
+}
+
+// Растущий буфер с началом на границе страницы; память не обнуляется
+class TextBuffer {
+public:
+    void reserve(size_t bytes) {
+        if (bytes <= capacity_) return;
+        bytes = (bytes + OUTPUT_ALIGNMENT - 1) / OUTPUT_ALIGNMENT * OUTPUT_ALIGNMENT;
+        Storage grown(static_cast<char*>(std::aligned_alloc(OUTPUT_ALIGNMENT, bytes)));
+        if (!grown) throw std::bad_alloc();
+        if (size_) std::memcpy(grown.get(), data_.get(), size_);
+        data_ = std::move(grown);
+        capacity_ = bytes;
+    }
+
+    template<typename T>
+    void append(const T& value, char sep) {
+        const size_t need = maxChars(value);
+        if (capacity_ - size_ < need) reserve(std::max(capacity_ * 2, size_ + need));
+        size_ = static_cast<size_t>(format(data_.get() + size_, data_.get() + capacity_, value, sep) - data_.get());
+    }
+
+    void append(const char* bytes, size_t n) {
+        if (capacity_ - size_ < n) reserve(std::max(capacity_ * 2, size_ + n));
+        std::memcpy(data_.get() + size_, bytes, n);
+        size_ += n;
+    }
+
+    const char* data() const { return data_.get(); }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    size_t room() const { return capacity_ - size_; }
+    void clear() { size_ = 0; }
+
+private:
+    struct Free { void operator()(char* p) const { std::free(p); } };
+    using Storage = std::unique_ptr<char, Free>;
+
+    Storage data_;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+};
+
+}  // namespace output_detail
+
+
+class OutputWriter {
+public:
+    OutputWriter() = default;
+    // io должен пережить писатель
+    explicit OutputWriter(const std::string& path, size_t bufferBytes = DEFAULT_OUTPUT_BUFFER,
+                          AsyncIO* io = nullptr) {
+        open(path, bufferBytes, io);
+    }
+    ~OutputWriter() { close(); }
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    bool open(const std::string& path, size_t bufferBytes = DEFAULT_OUTPUT_BUFFER, AsyncIO* io = nullptr) {
+        close();
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        failed_ = fd_ < 0;
+        offset_ = 0;
+        io_ = io && io->enabled() ? io : nullptr;
+        buffer_.clear();
+        buffer_.reserve(std::max(bufferBytes, OUTPUT_ALIGNMENT));
+        if (io_) spare_.reserve(buffer_.capacity());
+        return ok();
+    }
+
+    bool ok() const { return fd_ >= 0 && !failed_; }
+
+    // Значение и разделитель (по умолчанию перевод строки)
+    template<typename T>
+    void write(const T& value, char sep = '\n') {
+        const size_t need = output_detail::maxChars(value);
+        if (buffer_.room() < need) {
+            flush();
+            if (buffer_.room() < need) {   // строка длиннее всего буфера
+                writeDirect(value, sep);
+                return;
+            }
+        }
+        buffer_.append(value, sep);
+    }
+
+    void writeBytes(const void* data, size_t bytes) {
+        const char* p = static_cast<const char*>(data);
+        if (buffer_.room() < bytes) {
+            flush();
+            if (buffer_.capacity() < bytes && !io_) {
+                pwrite(p, bytes);
+                return;
+            }
+        }
+        // С асинхронной записью крупный кусок идёт через буферы по очереди:
+        // копия дешевле, чем ждать диск, и данные вызывающего не нужно держать
+        while (bytes > buffer_.room()) {
+            const size_t part = buffer_.room();
+            buffer_.append(p, part);
+            p += part;
+            bytes -= part;
+            flush();
+        }
+        buffer_.append(p, bytes);
+    }
+
+    // Все значения по одному на строку, блоки форматируются в threads потоках;
+    // threads == 0 — по числу ядер
+    template<typename T>
+    void writeAll(const std::vector<T>& values, size_t threads = 0) {
+        writeAll(values.size(), [&values](size_t i) -> const T& { return values[i]; }, threads);
+    }
+
+    // То же для значений valueAt(0) ... valueAt(count - 1)
+    template<typename ValueAt>
+    void writeAll(size_t count, ValueAt valueAt, size_t threads = 0) {
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        const size_t blocks = (count + OUTPUT_BLOCK_VALUES - 1) / OUTPUT_BLOCK_VALUES;
+        if (threads < 2 || blocks < 2) {
+            for (size_t i = 0; i < count; ++i) write(valueAt(i));
+            return;
+        }
+
+        flush();
+        waitPending();
+        std::vector<output_detail::TextBuffer> texts(std::min(threads, blocks));
+        std::vector<std::uint64_t> offsets(texts.size());
+        std::vector<char> written(texts.size());
+        for (size_t first = 0; first < blocks && ok(); first += texts.size()) {
+            const size_t wave = std::min(texts.size(), blocks - first);
+            output_detail::forEachPart(wave, [&](size_t w) {
+                auto& text = texts[w];
+                text.clear();
+                const size_t begin = (first + w) * OUTPUT_BLOCK_VALUES;
+                const size_t end = std::min(count, begin + OUTPUT_BLOCK_VALUES);
+                for (size_t i = begin; i < end; ++i) text.append(valueAt(i), '\n');
+            });
+            for (size_t w = 0; w < wave; ++w) {
+                offsets[w] = offset_;
+                offset_ += texts[w].size();
+            }
+            output_detail::forEachPart(wave, [&](size_t w) {
+                written[w] = output_detail::pwriteAll(fd_, texts[w].data(), texts[w].size(), offsets[w]);
+            });
+            failed_ = failed_ || std::find(written.begin(), written.begin() + wave, 0) != written.begin() + wave;
+        }
+    }
+
+    // Запись по абсолютному смещению в обход буфера (например, заголовок в
+    // начале файла); буфер сначала сбрасывается
+    bool writeAt(std::uint64_t offset, const void* data, size_t bytes) {
+        flush();
+        waitPending();
+        if (ok() && !output_detail::pwriteAll(fd_, static_cast<const char*>(data), bytes, offset))
+            failed_ = true;
+        return ok();
+    }
+
+    // Отдаёт буфер файлу; с AsyncIO запись завершится в фоне
+    bool flush() {
+        if (buffer_.size() == 0) return ok();
+        if (io_) {
+            waitPending();
+            const AsyncIO::Ticket ticket =
+                ok() ? io_->write(fd_, buffer_.data(), buffer_.size(), offset_) : AsyncIO::NO_TICKET;
+            if (ticket != AsyncIO::NO_TICKET) {
+                pending_ = ticket;
+                pendingBytes_ = buffer_.size();
+                offset_ += buffer_.size();
+                std::swap(buffer_, spare_);
+                buffer_.clear();
+                return ok();
+            }
+        }
+        pwrite(buffer_.data(), buffer_.size());
+        buffer_.clear();
+        return ok();
+    }
+
+    bool close() {
+        if (fd_ < 0) return !failed_;
+        flush();
+        waitPending();
+        if (::close(fd_) != 0) failed_ = true;
+        fd_ = -1;
+        return !failed_;
+    }
+
+    // Сколько байт уже отдано файлу или лежит в буфере
+    std::uint64_t size() const { return offset_ + buffer_.size(); }
+
+private:
+    void pwrite(const char* data, size_t bytes) {
+        if (ok() && !output_detail::pwriteAll(fd_, data, bytes, offset_)) failed_ = true;
+        offset_ += bytes;
+    }
+
+    void waitPending() {
+        if (pending_ == AsyncIO::NO_TICKET) return;
+        if (io_->wait(pending_) != static_cast<long>(pendingBytes_)) failed_ = true;
+        pending_ = AsyncIO::NO_TICKET;
+    }
+
+    template<typename T>
+    void writeDirect(const T& value, char sep) {
+        output_detail::TextBuffer single;
+        single.append(value, sep);
+        pwrite(single.data(), single.size());
+    }
+
+    int fd_ = -1;
+    bool failed_ = false;
+    std::uint64_t offset_ = 0;
+    output_detail::TextBuffer buffer_;
+
+    // Асинхронная запись: буфер в полёте и его размер
+    AsyncIO* io_ = nullptr;
+    output_detail::TextBuffer spare_;
+    AsyncIO::Ticket pending_ = AsyncIO::NO_TICKET;
+    size_t pendingBytes_ = 0;
+};
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncIO.hpp"
+
+
+// ---------- Инструментирование: счётчики, интервалы, трасса ----------
+//
+// Каждый поток пишет в свой журнал, заведённый при первом обращении;
+// глобальный мьютекс берётся только при регистрации журнала и при чтении
+// сводки. Счётчики — атомики с единственным писателем: прибавление — это
+// load и store без RMW и без блокировок, а читать их можно на ходу (так
+// работает ProgressReporter). В горячих циклах значения копятся в локальных
+// переменных и прибавляются пачками.
+//
+// Интервалы (ScopedTimer, record) пишутся только на крупных шагах — чанк,
+// проход, задача пула — и только если профилирование включено (--report,
+// --trace); иначе ScopedTimer стоит одну relaxed-загрузку флага. По
+// интервалам строится сводка JSON (число, сумма, максимум, p50/p99 для
+// каждого имени) и трасса в формате Chrome trace events (chrome://tracing,
+// Perfetto). Журналы читаются после того, как работа закончена.
+
+enum class Counter : unsigned {
+    InputBytes,          // байт входа отображено для разбора
+    ValuesParsed,        // значений разобрано во внешней сортировке
+    ValuesSorted,        // значений прошло через сортировку чанков
+    MergeComparisons,    // матчей дерева проигравших при слиянии
+    MergedValues,        // значений выдано слияниями (включая промежуточные проходы)
+    PoolTasks,           // задач выполнено ThreadPool
+    PoolQueueWaitNanos,  // сколько задачи ThreadPool простояли в очереди
+    Count
+};
+
+namespace profiler {
+
+constexpr size_t COUNTERS = static_cast<size_t>(Counter::Count);
+
+inline const char* counterName(size_t c) {
+    static const char* const names[COUNTERS] = {
+        "input_bytes", "values_parsed", "values_sorted", "merge_comparisons",
+        "merged_values", "pool_tasks", "pool_queue_wait_ns"};
+    return names[c];
+}
+
+// Наносекунды от первого обращения
+inline std::uint64_t now() {
+    static const auto epoch = std::chrono::steady_clock::now();
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+struct Span {
+    const char* name;   // строковый литерал
+    std::uint64_t start;
+    std::uint64_t duration;
+    std::uint64_t arg;  // например, номер рана или число значений
+};
+
+struct ThreadLog {
+    unsigned tid = 0;
+    std::array<std::atomic<std::uint64_t>, COUNTERS> counters{};
+    std::vector<Span> spans;
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadLog>> logs;
+    std::atomic<bool> enabled{false};
+};
+
+inline Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// Журнал текущего потока; живёт до конца программы
+inline ThreadLog& threadLog() {
+    thread_local ThreadLog* current = [] {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.logs.push_back(std::make_unique<ThreadLog>());
+        r.logs.back()->tid = static_cast<unsigned>(r.logs.size());
+        return r.logs.back().get();
+    }();
+    return *current;
+}
+
+inline void enable() {
+    now();   // отсчёт времени трассы — с момента включения
+    registry().enabled.store(true, std::memory_order_relaxed);
+}
+
+inline bool enabled() { return registry().enabled.load(std::memory_order_relaxed); }
+
+inline void add(Counter counter, std::uint64_t value) {
+    auto& slot = threadLog().counters[static_cast<size_t>(counter)];
+    slot.store(slot.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// Сумма счётчика по всем потокам
+inline std::uint64_t total(Counter counter) {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::uint64_t sum = 0;
+    for (const auto& l : r.logs) sum += l->counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+    return sum;
+}
+
+// Интервал [start, now()) с именем name
+inline void record(const char* name, std::uint64_t start, std::uint64_t arg = 0) {
+    if (!enabled()) return;
+    const std::uint64_t end = now();
+    threadLog().spans.push_back({name, start, end - start, arg});
+}
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const char* name, std::uint64_t arg = 0)
+        : name_(name), arg_(arg), active_(enabled()), start_(active_ ? now() : 0) {}
+    ~ScopedTimer() {
+        if (active_) record(name_, start_, arg_);
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    void setArg(std::uint64_t arg) { arg_ = arg; }
+
+private:
+    const char* name_;
+    std::uint64_t arg_;
+    bool active_;
+    std::uint64_t start_;
+};
+
+// Сводка: счётчики, ввод-вывод из ioStats() и статистика интервалов по именам
+inline bool writeSummary(const std::string& path, double wallSeconds) {
+    std::ofstream out(path);
+    if (!out) return false;
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    std::array<std::uint64_t, COUNTERS> sums{};
+    std::map<std::string, std::vector<std::uint64_t>> durations;
+    for (const auto& l : r.logs) {
+        for (size_t c = 0; c < COUNTERS; ++c) sums[c] += l->counters[c].load(std::memory_order_relaxed);
+        for (const auto& s : l->spans) durations[s.name].push_back(s.duration);
+    }
+
+    const auto& io = ioStats();
+    out << std::fixed << std::setprecision(6) << "{\n  \"wall_seconds\": " << wallSeconds
+        << ",\n  \"threads\": " << r.logs.size() << ",\n  \"counters\": {\n"
+        << "    \"bytes_read\": " << io.bytesRead.load() << ",\n"
+        << "    \"bytes_written\": " << io.bytesWritten.load() << ",\n"
+        << "    \"io_wait_ns\": " << io.waitNanos.load();
+    for (size_t c = 0; c < COUNTERS; ++c) out << ",\n    \"" << counterName(c) << "\": " << sums[c];
+    out << "\n  },\n  \"spans\": {";
+    bool first = true;
+    for (auto& [name, d] : durations) {
+        std::sort(d.begin(), d.end());
+        std::uint64_t sum = 0;
+        for (auto v : d) sum += v;
+        auto seconds = [](std::uint64_t ns) { return static_cast<double>(ns) / 1e9; };
+        out << (first ? "\n" : ",\n") << "    \"" << name << "\": {\"count\": " << d.size()
+            << ", \"total_seconds\": " << seconds(sum) << ", \"max_seconds\": " << seconds(d.back())
+            << ", \"p50_seconds\": " << seconds(d[d.size() / 2])
+            << ", \"p99_seconds\": " << seconds(d[std::min(d.size() - 1, d.size() * 99 / 100)]) << "}";
+        first = false;
+    }
+    out << "\n  }\n}\n";
+    return static_cast<bool>(out);
+}
+
+// Все интервалы в формате Chrome trace events, времена в микросекундах
+inline bool writeTrace(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) return false;
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for (const auto& l : r.logs) {
+        out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << l->tid
+            << ", \"args\": {\"name\": \"thread " << l->tid << "\"}}";
+        first = false;
+        for (const auto& s : l->spans)
+            out << ",\n{\"name\": \"" << s.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << l->tid
+                << ", \"ts\": " << static_cast<double>(s.start) / 1e3
+                << ", \"dur\": " << static_cast<double>(s.duration) / 1e3 << ", \"args\": {\"n\": " << s.arg << "}}";
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
+
+}  // namespace profiler
+
+
+// Печатает счётчик раз в period, пока жив, если он изменился: прогресс
+// читается из журналов, а не печатается из горячего цикла
+class ProgressReporter {
+public:
+    ProgressReporter(const char* label, Counter counter,
+                     std::chrono::milliseconds period = std::chrono::milliseconds(1000))
+        : thread_([this, label, counter, period] {
+              std::uint64_t shown = profiler::total(counter);
+              std::unique_lock<std::mutex> lock(mutex_);
+              while (!cv_.wait_for(lock, period, [this] { return stop_; })) {
+                  const std::uint64_t value = profiler::total(counter);
+                  if (value != shown) std::cout << label << value << std::endl;
+                  shown = value;
+              }
+          }) {}
+
+    ~ProgressReporter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        thread_.join();
+    }
+
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;   // последним: поток стартует, когда остальное готово
+};
@@ -1,9 +1,17 @@
 #pragma once
 
+#include <algorithm>
 #include <queue>
 #include <functional>
 #include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <atomic>
 
@@ -13,13 +21,120 @@ public:
     explicit ThreadPool(size_t numThreads);
     ~ThreadPool();
 
+    size_t size() const { return workers.size(); }
+
     void enqueue(std::function<void()> task);
 
+    // Задача с результатом: значение или исключение задачи придёт через future
+    template<typename F>
+    auto submit(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using R = std::invoke_result_t<std::decay_t<F>>;
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+        std::future<R> result = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return result;
+    }
+
+    // Вызывает fn(i) для каждого i из [begin, end), порциями по grain индексов,
+    // и ждёт завершения. Первое исключение из fn пробрасывается вызывающему.
+    // Вызывать из задачи этого же пула нельзя: ожидающий воркер не выполняет
+    // чужие задачи.
+    template<typename Fn>
+    void parallel_for(size_t begin, size_t end, size_t grain, Fn&& fn);
+
 private:
+    // Задача и момент постановки: время в очереди копится в профилировщике
+    struct QueuedTask {
+        std::function<void()> run;
+        std::uint64_t enqueuedAt;
+    };
+
     std::vector<std::thread> workers;
-    std::queue<std::function<void()>> tasks;
+    std::queue<QueuedTask> tasks;
 
     std::mutex queueMutex;
     std::condition_variable condition;
     bool stop = false;
 };
+
+
+// Группа задач на ThreadPool: run() ставит задачу, wait() блокируется до
+// завершения всех поставленных задач и пробрасывает первое исключение.
+// Ожидание — на условной переменной, без опроса.
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool(pool) {}
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    // Группа не должна разрушаться раньше своих задач
+    ~TaskGroup() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+    template<typename F>
+    void run(F&& f) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++pending;
+        }
+        pool.enqueue([this, f = std::forward<F>(f)]() mutable {
+            std::exception_ptr failure;
+            try {
+                f();
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (failure && !error) error = failure;
+            if (--pending == 0) done.notify_all();
+        });
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+        if (error) {
+            std::exception_ptr failure = std::exchange(error, nullptr);
+            std::rethrow_exception(failure);
+        }
+    }
+
+private:
+    ThreadPool& pool;
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t pending = 0;
+    std::exception_ptr error;
+};
+
+
+template<typename Fn>
+void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain, Fn&& fn) {
+    if (begin >= end) return;
+    if (grain == 0) grain = 1;
+    const size_t chunks = (end - begin + grain - 1) / grain;
+
+    // Каждая задача забирает следующую порцию, пока они не кончатся;
+    // после первой ошибки новые порции не раздаются
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    TaskGroup group(*this);
+    const size_t tasks = std::min(chunks, std::max<size_t>(size(), 1));
+    for (size_t t = 0; t < tasks; ++t) {
+        group.run([&]() {
+            try {
+                for (size_t c = next++; c < chunks && !failed; c = next++) {
+                    const size_t last = std::min(end, begin + (c + 1) * grain);
+                    for (size_t i = begin + c * grain; i < last; ++i) fn(i);
+                }
+            } catch (...) {
+                failed = true;
+                throw;
+            }
+        });
+    }
+    group.wait();
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// Пул с перехватом работы (work stealing).
+// У каждого воркера своя дека Chase–Lev: владелец кладёт и берёт задачи с
+// нижнего конца без блокировок, простаивающие воркеры крадут с верхнего.
+// Задачи из сторонних потоков попадают в общую очередь инъекции.
+// Задача хранит небольшую лямбду прямо в себе (InlineTask), сами задачи
+// переиспользуются через список свободных у каждого воркера, так что в
+// установившемся режиме spawn не выделяет память.
+//
+// Fork/join: spawn(group, f) + wait(group). wait() на воркере не блокирует
+// поток, а выполняет задачи — свои и украденные, пока группа не завершится,
+// поэтому рекурсивные сортировки не взаимоблокируются. Корень рекурсии
+// удобно запускать задачей (spawn + wait из основного потока), тогда всё
+// дерево порождается в деки воркеров, минуя общую очередь. Исключение задачи
+// группы не роняет воркер: группа всё равно завершается, а первое исключение
+// пробрасывает wait(), как TaskGroup у ThreadPool.
+
+
+// Вызываемый объект с буфером на INLINE_SIZE байт; больший уходит в кучу
+class InlineTask {
+public:
+    static constexpr size_t INLINE_SIZE = 48;
+
+    InlineTask() = default;
+    InlineTask(const InlineTask&) = delete;
+    InlineTask& operator=(const InlineTask&) = delete;
+    ~InlineTask() { reset(); }
+
+    template<typename F>
+    void emplace(F&& f) {
+        using Fn = std::decay_t<F>;
+        reset();
+        if constexpr (sizeof(Fn) <= INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t) &&
+                      std::is_nothrow_move_constructible_v<Fn>) {
+            target = ::new (static_cast<void*>(storage)) Fn(std::forward<F>(f));
+            destroy = [](void* p) { static_cast<Fn*>(p)->~Fn(); };
+        } else {
+            target = new Fn(std::forward<F>(f));
+            destroy = [](void* p) { delete static_cast<Fn*>(p); };
+        }
+        invoke = [](void* p) { (*static_cast<Fn*>(p))(); };
+    }
+
+    void operator()() { invoke(target); }
+
+    void reset() {
+        if (destroy) destroy(target);
+        destroy = nullptr;
+        invoke = nullptr;
+        target = nullptr;
+    }
+
+private:
+    alignas(std::max_align_t) unsigned char storage[INLINE_SIZE];
+    void* target = nullptr;
+    void (*invoke)(void*) = nullptr;
+    void (*destroy)(void*) = nullptr;
+};
+
+
+class WorkStealingPool {
+public:
+    // Счётчик незавершённых задач fork/join
+    class Group {
+    public:
+        Group() = default;
+        Group(const Group&) = delete;
+        Group& operator=(const Group&) = delete;
+
+        bool done() const { return (pending.load(std::memory_order_acquire) & ~BLOCKING) == 0; }
+
+    private:
+        friend class WorkStealingPool;
+        // Старший бит — группу ждёт сторонний поток, без него завершение
+        // обходится без notify. Флаг живёт в том же слове, что и счётчик:
+        // после последнего fetch_sub группа может быть уже разрушена, и
+        // читать из неё отдельное поле нельзя. По той же причине будят
+        // ждущего не через pending, а через слово пула released.
+        static constexpr size_t BLOCKING = size_t{1} << (sizeof(size_t) * 8 - 1);
+        std::atomic<size_t> pending{0};
+        // Первое исключение задач; пишется до fetch_sub своей задачи, читается
+        // в wait() после того, как счётчик дошёл до нуля
+        std::atomic<bool> failed{false};
+        std::exception_ptr error;
+    };
+
+    explicit WorkStealingPool(size_t numThreads);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    // Порождает задачу группы; с воркера — в его деку, иначе — в очередь инъекции
+    template<typename F>
+    void spawn(Group& group, F&& f) {
+        group.pending.fetch_add(1, std::memory_order_relaxed);
+        Job* job = allocateJob();
+        job->task.emplace(std::forward<F>(f));
+        job->group = &group;
+        schedule(job);
+    }
+
+    // Задача без ожидания; исключение из неё, как и у ThreadPool::enqueue,
+    // завершает программу
+    template<typename F>
+    void submit(F&& f) {
+        Job* job = allocateJob();
+        job->task.emplace(std::forward<F>(f));
+        job->group = nullptr;
+        schedule(job);
+    }
+
+    // Ждёт завершения всех задач группы. На воркере тем временем выполняет
+    // доступную работу, сторонний поток просто засыпает. Если задача группы
+    // бросила исключение, первое из них пробрасывается отсюда
+    void wait(Group& group);
+
+private:
+    struct Job {
+        InlineTask task;
+        Group* group = nullptr;
+        Job* nextFree = nullptr;
+    };
+
+    // Дека Chase–Lev (в варианте Lê, Pop, Cohen, Zappa Nardelli для модели
+    // памяти C11). Массив растёт удвоением, старые массивы живут до
+    // разрушения деки: вор мог успеть прочитать указатель на них.
+    class Deque {
+    public:
+        Deque();
+        void push(Job* job);   // только владелец
+        Job* pop();            // только владелец
+        Job* steal();          // любой поток
+
+    private:
+        struct Array {
+            explicit Array(int64_t capacity)
+                : capacity(capacity), slots(new std::atomic<Job*>[capacity]) {}
+            Job* get(int64_t i) const { return slots[i & (capacity - 1)].load(std::memory_order_relaxed); }
+            void put(int64_t i, Job* job) { slots[i & (capacity - 1)].store(job, std::memory_order_relaxed); }
+
+            int64_t capacity;
+            std::unique_ptr<std::atomic<Job*>[]> slots;
+        };
+
+        Array* grow(Array* old, int64_t top, int64_t bottom);
+
+        alignas(64) std::atomic<int64_t> top{0};
+        alignas(64) std::atomic<int64_t> bottom{0};
+        std::atomic<Array*> array;
+        std::vector<std::unique_ptr<Array>> arrays;   // текущий и все прежние
+    };
+
+    struct Worker {
+        Deque deque;
+        Job* freeList = nullptr;
+        std::thread thread;
+    };
+
+    Job* allocateJob();
+    void releaseJob(Job* job);
+    void schedule(Job* job);
+    void execute(Job* job);
+    static void rethrowFailure(Group& group);
+    Job* findJob(Worker* self);
+    void workerLoop(size_t index);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::mutex injectionMutex;
+    std::deque<Job*> injection;
+    std::atomic<size_t> injected{0};
+
+    // Поколение работы: растёт при каждой новой задаче, спящие воркеры ждут его смены
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<size_t> sleepers{0};
+    std::atomic<bool> stop{false};
+
+    // Сколько раз завершилась группа со сторонним ждущим; такие ждущие спят
+    // на этом слове, а не на счётчике группы, который может исчезнуть сразу
+    // после последнего fetch_sub
+    std::atomic<uint32_t> released{0};
+
+    static thread_local WorkStealingPool* currentPool;
+    static thread_local Worker* currentWorker;
+};
@@ -13,14 +13,30 @@
 #include <list>
 #include <cmath>
 #include <algorithm>
-#include <queue>
+#include <bit>
 #include <optional>
 #include <functional>
 #include <cstdio>
 #include <iomanip>            
 #include <limits>
+#include <memory>
+#include <chrono>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "ThreadPool.hpp"
+#include "BoundedQueue.hpp"
+#include "AsyncIO.hpp"
+#include "runFormat.hpp"
+#include "MappedInput.hpp"
+#include "LoserTree.hpp"
+#include "Profiler.hpp"
+#include "radixSort.hpp"
+#include "stringSort.hpp"
+#include "quickSort.hpp"
 
 namespace fs = std::filesystem;
 
@@ -35,328 +51,1017 @@ template<typename T>
 constexpr bool is_number = std::is_arithmetic<T>::value;
 
 template<typename T>
-bool writeChunk(const std::string& filename, const std::vector<T>& data) {
-    std::ofstream out(filename);
-    if (!out) return false;
-
-    // Для плавающей точки настраиваем фиксированный формат и максимальную точность
-    if constexpr (std::is_floating_point_v<T>) {
-        out << std::fixed
-            << std::setprecision(std::numeric_limits<T>::max_digits10);
-    }
-
-    if constexpr (std::is_floating_point_v<T>) {
-    std::cout << "[DEBUG] formatting floats with precision = "
-              << std::numeric_limits<T>::max_digits10 << "\n";
-    out << std::fixed
-        << std::setprecision(std::numeric_limits<T>::max_digits10);
-    }
+bool writeChunk(const std::string& filename, const std::vector<T>& data,
+                RunFormat format = RunFormat::Binary, RunOrder order = RunOrder::Unsorted,
+                AsyncIO* io = nullptr) {
+    profiler::ScopedTimer timer("chunk.write", data.size());
+    RunWriter<T> out(filename, format, order, 0, io);
+    if (!out.ok()) return false;
+    out.write(data);
+    return out.close();
+}
 
 
-    for (const auto& item : data) {
-        out << item << "\n";
-    }
-    return true;
-}
+// Размер чанка в байтах (100 МБ)
+constexpr std::uint64_t CHUNK_SIZE = 100ULL * 1024 * 1024;
 
+// Бюджет памяти по умолчанию: заполняемый буфер, сортируемый буфер и
+// буфер слияния mergeSort — по одному чанку на каждый
+constexpr std::uint64_t DEFAULT_MEMORY_BUDGET = 3 * CHUNK_SIZE;
+
+// Буфер записи итогового файла при слиянии
+constexpr std::uint64_t DEFAULT_WRITE_BUFFER = 8ULL * 1024 * 1024;
+
+// Как нарезаются раны: буферами фиксированного размера или выбором с замещением
+enum class RunStrategy { Fixed, Replacement };
+
+// Настройки внешней сортировки
+struct ExternalSortConfig {
+    RunFormat runFormat = RunFormat::Binary;            // --text-runs переключает на текст
+    std::uint64_t memoryBudget = DEFAULT_MEMORY_BUDGET; // --memory
+    bool pipeline = false;                              // --pipeline
+    RunStrategy runStrategy = RunStrategy::Fixed;       // --runs fixed|replacement
+    std::uint64_t readBlockBytes = DEFAULT_READ_BLOCK;  // --read-block, упреждающее чтение на ран
+    std::uint64_t writeBufferBytes = DEFAULT_WRITE_BUFFER; // --write-buffer, буфер итогового файла
+    unsigned mergeThreads = 1;                          // --merge-threads, 0 — все ядра
+    std::uint64_t maxFanIn = 0;                         // --max-fan-in, 0 — из бюджета памяти
+    unsigned ioDepth = AsyncIO::DEFAULT_DEPTH;          // --io-depth, 0 — синхронный ввод-вывод
+    bool unique = false;                                // --unique, повторы выкидываются в ранах и при слиянии
+};
 
-template<typename T>
-bool readChunk(const std::string& filename, std::vector<T>& data) {
-    std::ifstream in(filename);
-    if (!in) return false;
-    std::string line;
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
-        if constexpr (is_number<T>) {
-            std::istringstream iss(line);
-            T value;
-            iss >> value;
-            if (!iss.fail()) data.push_back(value);
+// Время фазы и сколько из него потоки простояли в ожидании ввода-вывода
+class IOPhaseReport {
+public:
+    IOPhaseReport(std::string name, const ExternalSortConfig& config)
+        : name_(std::move(name)), depth_(config.ioDepth), start_(std::chrono::steady_clock::now()),
+          waitStart_(ioStats().waitNanos.load()) {}
+
+    // summedOver — по каким потокам суммировано ожидание; nullptr — фаза
+    // ждёт ввод-вывод в одном потоке, и остальное время — вычисления
+    void print(const char* summedOver = nullptr) const {
+        const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+        const double wait = static_cast<double>(ioStats().waitNanos.load() - waitStart_) / 1e9;
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(2) << name_ << ": " << wall << " с, ожидание ввода-вывода "
+             << wait << " с";
+        if (!summedOver) {
+            line << " (" << static_cast<int>(wall > 0 ? 100 * wait / wall : 0) << "%), вычисления "
+                 << std::max(0.0, wall - wait) << " с";
         } else {
-            data.push_back(line);
+            line << " (сумма по " << summedOver << ")";
         }
+        line << " [" << AsyncIO::describe(depth_);
+        if (depth_) line << ", глубина " << depth_;
+        line << "]";
+        std::cout << line.str() << std::endl;
     }
-    return true;
-}
 
-// Размер чанка в байтах (100 МБ)
-constexpr std::uint64_t CHUNK_SIZE = 100ULL * 1024 * 1024;
+private:
+    std::string name_;
+    unsigned depth_;
+    std::chrono::steady_clock::time_point start_;
+    std::uint64_t waitStart_;
+};
+
+// Чтение одного значения из отображённого входа; пустые строки пропускаются
+template<typename T>
+bool readValue(InputCursor& in, T& value) {
+    return in.next(value);
+}
 
-bool openFile(const std::string& filename, std::ifstream& in) {
-    in.open(filename, std::ios::binary);
-    if (!in.is_open()) {
+// Вход отображается в память; курсор по мере чтения отдаёт пройденные
+// страницы, так что резидентная память остаётся в пределах бюджета
+inline MappedInput openInput(const std::string& filename) {
+    MappedInput input(filename);
+    if (!input.ok()) {
         std::cerr << "Ошибка: не удалось открыть файл \"" << filename << "\"\n";
-        return false;
+        std::exit(EXIT_FAILURE);
     }
-    return true;
+    profiler::add(Counter::InputBytes, input.size());
+    return input;
 }
 
-std::uint64_t countChunks(const fs::path& path) {
-    const auto fileSize = fs::file_size(path);
-    return (fileSize + CHUNK_SIZE - 1) / CHUNK_SIZE;  // округление вверх
+// Сколько памяти занимает значение в буфере чанка (для строк — оценка)
+template<typename T>
+std::uint64_t approxBytes(const T& value) {
+    if constexpr (is_number<T>) return sizeof(T);
+    else return sizeof(T) + value.size();
 }
 
-int splitIntoChunks(const std::string& filename) {
-    std::ifstream in;
-    if (!openFile(filename, in)) {
-        std::exit(EXIT_FAILURE);
-    }
 
-    fs::path filepath{filename};
-    std::uint64_t totalChunks = countChunks(filepath);
-    std::cout << "Всего чанков: " << totalChunks << "\n";
-
-    for (std::uint64_t chunkIndex = 0; chunkIndex < totalChunks; ++chunkIndex) {
-        // Формируем имя для чанка, например: filename.part0, .part1 и т.д.
-        std::string outName = filename + ".part" + std::to_string(chunkIndex);
-        std::ofstream out(outName, std::ios::binary);
-        if (!out) {
-            std::cerr << "Ошибка: не удалось создать файл-чанк \"" << outName << "\"\n";
-            break;
-        }
 
-        // Сколько байт читать в этом чанке
-        std::uint64_t bytesToRead = CHUNK_SIZE;
-        // Для последнего чанка может быть меньше
-        const auto currentPos = chunkIndex * CHUNK_SIZE;
-        const auto fileSize = fs::file_size(filepath);
-        if (currentPos + CHUNK_SIZE > fileSize) {
-            bytesToRead = fileSize - currentPos;
+// ---------- Merge Sort for vector with custom comparator ----------
+//
+// Сортировка снизу вверх: сначала отрезки по MERGE_SORT_RUN досортировываются
+// вставками на месте, затем проходы слияния ходят между data и вторым буфером
+// (ping-pong), без копирования обратно; если результат оказался во втором
+// буфере, векторы просто меняются местами. Слияние устойчиво: при равенстве
+// берётся левый элемент. Для чисел выбор элемента записан без ветвления —
+// на случайных данных условный переход в нём угадывается через раз.
+//
+// Второй буфер передаёт вызывающий. Чанки сортируются в воркерах пула, и у
+// каждого воркера свой набор буферов (sortScratch), который переживает чанк:
+// после первого чанка сортировка и чтение следующих чанков того же размера
+// памяти не выделяют.
+
+constexpr size_t MERGE_SORT_RUN = 24;
+
+// Сливает отсортированные [left, mid) и [mid, right) из src в dst
+template<typename T, typename Compare>
+void mergeRange(T* src, T* dst, size_t left, size_t mid, size_t right, Compare& comp) {
+    size_t a = left, b = mid, idx = left;
+    if (mid == right || !comp(src[mid], src[mid - 1])) {
+        // Половины уже идут по порядку (частый случай на почти отсортированном входе)
+        std::move(src + left, src + right, dst + left);
+        return;
+    }
+    if constexpr (std::is_arithmetic_v<T>) {
+        while (a < mid && b < right) {
+            const T x = src[a];
+            const T y = src[b];
+            const bool takeRight = comp(y, x);
+            dst[idx++] = takeRight ? y : x;
+            a += !takeRight;
+            b += takeRight;
         }
-
-        // Буфер и чтение/запись
-        std::vector<char> buffer(4096);
-        std::uint64_t bytesReadTotal = 0;
-        while (bytesReadTotal < bytesToRead && in) {
-            std::uint64_t toRead = std::min<std::uint64_t>(buffer.size(), bytesToRead - bytesReadTotal);
-            in.read(buffer.data(), toRead);
-            std::streamsize n = in.gcount();
-            if (n <= 0) break;
-            out.write(buffer.data(), n);
-            bytesReadTotal += static_cast<std::uint64_t>(n);
+    } else {
+        while (a < mid && b < right) {
+            if (!comp(src[b], src[a]))  // src[a] <= src[b]
+                dst[idx++] = std::move(src[a++]);
+            else
+                dst[idx++] = std::move(src[b++]);
         }
-        out.close();
-        std::cout << "Создан: " << outName << " (" << bytesReadTotal << " байт)\n";
     }
+    idx = std::move(src + a, src + mid, dst + idx) - dst;
+    std::move(src + b, src + right, dst + idx);
+}
 
-    in.close();
-
-    return totalChunks;
+// Слияние в out; out переиспользуется, его ёмкость сохраняется между вызовами
+template<typename T, typename Compare = std::less<T>>
+void merge(const std::vector<T>& left, const std::vector<T>& right, std::vector<T>& out,
+           Compare comp = Compare()) {
+    out.resize(left.size() + right.size());
+    size_t i = 0, j = 0, idx = 0;
+    if constexpr (std::is_arithmetic_v<T>) {
+        while (i < left.size() && j < right.size()) {
+            const T x = left[i];
+            const T y = right[j];
+            const bool takeRight = comp(y, x);
+            out[idx++] = takeRight ? y : x;
+            i += !takeRight;
+            j += takeRight;
+        }
+    } else {
+        while (i < left.size() && j < right.size()) {
+            if (!comp(right[j], left[i]))  // left[i] <= right[j]
+                out[idx++] = left[i++];
+            else
+                out[idx++] = right[j++];
+        }
+    }
+    idx = std::copy(left.begin() + i, left.end(), out.begin() + idx) - out.begin();
+    std::copy(right.begin() + j, right.end(), out.begin() + idx);
 }
 
+template<typename T, typename Compare = std::less<T>>
+std::vector<T> merge(const std::vector<T>& left, const std::vector<T>& right, Compare comp = Compare()) {
+    std::vector<T> result;
+    merge(left, right, result, comp);
+    return result;
+}
 
-template<typename T>
-int splitIntoChunks(const std::string& filename) {
-    static_assert(std::is_arithmetic_v<T>, "Тип должен быть числовым");
+// Сортирует data; scratch — второй буфер, после вызова в нём мусор
+template<typename T, typename Compare = std::less<T>>
+void mergeSort(std::vector<T>& data, std::vector<T>& scratch, Compare comp = Compare()) {
+    const size_t n = data.size();
+    for (size_t i = 0; i < n; i += MERGE_SORT_RUN)
+        insertionSort(data, i, std::min(i + MERGE_SORT_RUN, n), comp);
+    if (n <= MERGE_SORT_RUN)
+        return;
 
-    // Считаем все данные из файла
-    std::ifstream in(filename);
-    if (!in) {
-        std::cerr << "Ошибка: не удалось открыть файл \"" << filename << "\"\n";
-        std::exit(EXIT_FAILURE);
+    scratch.resize(n);
+    T* src = data.data();
+    T* dst = scratch.data();
+    for (size_t width = MERGE_SORT_RUN; width < n; width *= 2) {
+        for (size_t i = 0; i < n; i += 2 * width) {
+            const size_t mid = std::min(i + width, n);
+            mergeRange(src, dst, i, mid, std::min(i + 2 * width, n), comp);
+        }
+        std::swap(src, dst);
     }
+    if (src != data.data()) data.swap(scratch);
+}
 
-    // Собираем все значения в вектор
-    std::vector<T> data;
-    T value;
-    while (in >> value) {
-        data.push_back(value);
-    }
-    in.close();
+// Буферы сортировки чанков, свои у каждого потока
+template<typename T>
+struct SortScratch {
+    std::vector<T> values;               // второй буфер mergeSort и radixSort
+    StringArena arena;                   // строки чанка для stringSort
+    std::vector<StringRecord> records;   // буфер раскладки stringSort
+};
 
-    // Сколько элементов в одном чанке
-    const std::size_t elementsPerChunk = CHUNK_SIZE / sizeof(T);
-    // Сколько всего чанков
-    int totalChunks = static_cast<int>((data.size() + elementsPerChunk - 1) / elementsPerChunk);
-    std::cout << "Всего чанков: " << totalChunks << "\n";
+template<typename T>
+SortScratch<T>& sortScratch() {
+    thread_local SortScratch<T> scratch;
+    return scratch;
+}
 
-    // Разбиваем и пишем
-    for (int chunkIndex = 0; chunkIndex < totalChunks; ++chunkIndex) {
-        size_t start = chunkIndex * elementsPerChunk;
-        size_t end   = std::min(start + elementsPerChunk, data.size());
+template<typename T, typename Compare = std::less<T>>
+std::vector<T> mergeSort(std::vector<T>&& input, Compare comp = Compare()) {
+    mergeSort(input, sortScratch<T>().values, comp);
+    return std::move(input);
+}
 
-        std::string outName = filename + ".part" + std::to_string(chunkIndex);
 
-        // writeChunk<T> пишет каждый элемент в отдельную строку
-        if (!writeChunk<T>(outName, std::vector<T>(data.begin() + start, data.begin() + end))) {
-            std::cerr << "Ошибка: не удалось создать файл-чанк \"" << outName << "\"\n";
-        } else {
-            std::cout << "Создан: " << outName
-                      << " (" << (end - start) << " элементов)\n";
+// Сортировка чанка в памяти: числа в порядке less/greater — поразрядно,
+// строки — через арену MSD-сортировкой, остальное — слиянием. Чанк
+// сортируется внутри задачи пула, поэтому обе поразрядные сортировки здесь
+// однопоточные: параллельны сами чанки. Вспомогательные буферы берутся из
+// sortScratch потока.
+template<typename T, typename Compare = std::less<T>>
+void sortChunk(std::vector<T>& data, Compare comp = Compare()) {
+    profiler::ScopedTimer timer("chunk.sort", data.size());
+    profiler::add(Counter::ValuesSorted, data.size());
+    constexpr RunOrder order = run_order_of<Compare>::value;
+    auto& scratch = sortScratch<T>();
+    if constexpr (is_number<T> && order != RunOrder::Unsorted) {
+        radixSort(data, order == RunOrder::Descending, nullptr, &scratch.values);
+    } else if constexpr (std::is_same_v<T, std::string> && order != RunOrder::Unsorted) {
+        StringArena& arena = scratch.arena;
+        arena.clear();
+        size_t bytes = 0;
+        for (const auto& s : data) bytes += s.size();
+        arena.reserve(data.size(), bytes);
+        for (const auto& s : data) arena.add(s);
+        stringSort(arena, order == RunOrder::Descending, nullptr, &scratch.records);
+        // Строки чанка переиспользуются: assign не выделяет память, если влезает
+        for (size_t i = 0; i < data.size(); ++i) {
+            const std::string_view sorted = arena.view(arena.records[i]);
+            data[i].assign(sorted.data(), sorted.size());
         }
+    } else {
+        mergeSort(data, scratch.values, comp);
     }
-
-    return totalChunks;
 }
 
+// Оставляет по одному значению из каждой группы равных в отсортированном
+// буфере: ран становится короче ещё до записи на диск
+template<typename T, typename Compare>
+void dropRepeats(std::vector<T>& data, Compare comp) {
+    data.erase(std::unique(data.begin(), data.end(),
+                           [&comp](const T& kept, const T& next) { return !comp(kept, next); }),
+               data.end());
+}
 
+// Сортирует буфер и сбрасывает его на диск готовым раном
+template<typename T, typename Compare = std::less<T>>
+bool spillRun(const std::string& path, std::vector<T>& data, RunFormat format, Compare comp = Compare(),
+              AsyncIO* io = nullptr, bool unique = false) {
+    sortChunk<T, Compare>(data, comp);
+    if (unique) dropRepeats(data, comp);
+    if (!writeChunk<T>(path, data, format, run_order_of<Compare>::value, io)) {
+        std::cerr << "Ошибка записи: " << path << "\n";
+        return false;
+    }
+    std::cout << "Отсортирован: " << path << " (" << data.size() << " элементов)\n";
+    return true;
+}
 
-// ---------- Merge Sort for vector with custom comparator ----------
-
+// ---------- Потоковая генерация ранов ----------
+//
+// Вход читается один раз. Значения копятся в буфере размером memoryBudget / 3;
+// заполненный буфер сортируется и сбрасывается раном в фоновой задаче, пока
+// основной поток заполняет следующий. Одновременно живут заполняемый буфер,
+// сортируемый буфер и буфер слияния mergeSort, поэтому пик памяти не зависит
+// от размера входа. Если сброс рана не удался, чтение входа прекращается и
+// возвращается false; в totalRuns — сколько ранов было начато.
 
 template<typename T, typename Compare = std::less<T>>
-std::vector<T> merge(const std::vector<T>& left, const std::vector<T>& right, Compare comp = Compare()) {
-    std::vector<T> result;
-    size_t i = 0, j = 0;
-    result.reserve(left.size() + right.size());
+bool generateRuns(const std::string& filename, int& totalRuns, const ExternalSortConfig& config = {},
+                  Compare comp = Compare()) {
+    MappedInput input = openInput(filename);
+    InputCursor in(input);
+
+    const std::uint64_t bufferBytes = std::max<std::uint64_t>(config.memoryBudget / 3, sizeof(T));
+    const RunFormat format = config.runFormat;
+
+    std::vector<T> filling, spilling;
+    if constexpr (is_number<T>) {
+        filling.reserve(bufferBytes / sizeof(T));
+        spilling.reserve(bufferBytes / sizeof(T));
+    }
 
-    while (i < left.size() && j < right.size()) {
-        if (!comp(right[j], left[i]))  // left[i] <= right[j]
-            result.push_back(left[i++]);
-        else
-            result.push_back(right[j++]);
+    // Сбросы идут по очереди (get() ниже), так что один AsyncIO на все
+    AsyncIO spillIO(config.ioDepth);
+    ThreadPool spiller(1);
+    std::future<bool> spilled;
+    bool spillFailed = false;
+    totalRuns = 0;
+
+    // Разбор входа в буфер — интервал chunk.parse от начала заполнения
+    std::uint64_t fillStart = profiler::now();
+
+    // get() дожидается предыдущего сброса и пробрасывает его исключение
+    auto waitSpill = [&]() {
+        if (spilled.valid() && !spilled.get()) spillFailed = true;
+    };
+    auto startSpill = [&]() {
+        profiler::record("chunk.parse", fillStart, filling.size());
+        profiler::add(Counter::ValuesParsed, filling.size());
+        waitSpill();
+        if (spillFailed) return;
+        std::swap(filling, spilling);
+        filling.clear();
+        std::string path = filename + ".part" + std::to_string(totalRuns++);
+        spilled = spiller.submit([&spilling, &spillIO, path, format, comp, unique = config.unique]() {
+            return spillRun<T, Compare>(path, spilling, format, comp, &spillIO, unique);
+        });
+        fillStart = profiler::now();
+    };
+
+    T value;
+    std::uint64_t bytes = 0;
+    while (!spillFailed && readValue(in, value)) {
+        bytes += approxBytes(value);
+        filling.push_back(std::move(value));
+        if (bytes >= bufferBytes) {
+            startSpill();
+            bytes = 0;
+        }
     }
-    while (i < left.size()) result.push_back(left[i++]);
-    while (j < right.size()) result.push_back(right[j++]);
-    return result;
+    if (!spillFailed && !filling.empty()) startSpill();
+    waitSpill();
+    if (spillFailed) return false;
+
+    std::cout << "Всего ранов: " << totalRuns << "\n";
+    return true;
 }
 
+// ---------- Конвейерная генерация ранов ----------
+//
+// Три стадии работают одновременно:
+//   чтение (вызывающий поток) -> сортировка (воркеры ThreadPool) -> запись (отдельный поток).
+// Между стадиями — очереди BoundedQueue. Буферы ходят по кругу через очередь
+// свободных буферов, их ровно workers + 2, так что чтение упирается в
+// сортировку и запись, а память ограничена бюджетом: на каждого воркера
+// дополнительно приходится буфер слияния mergeSort.
+
+template<typename T>
+struct RunBatch {
+    int index = 0;
+    std::vector<T> data;
+};
+
 template<typename T, typename Compare = std::less<T>>
-std::vector<T> mergeSort(std::vector<T>&& input, Compare comp = Compare()) {
-    if (input.size() <= 1)
-        return std::move(input);
-
-    std::vector<T> buffer(input.size());
-    std::vector<T>* src = &input;
-    std::vector<T>* dst = &buffer;
-
-    for (size_t width = 1; width < input.size(); width *= 2) {
-        for (size_t i = 0; i < input.size(); i += 2 * width) {
-            size_t left = i;
-            size_t mid = std::min(i + width, input.size());
-            size_t right = std::min(i + 2 * width, input.size());
-
-            size_t a = left, b = mid, idx = left;
-            while (a < mid && b < right) {
-                if (!comp((*src)[b], (*src)[a]))  // (*src)[a] <= (*src)[b]
-                    (*dst)[idx++] = std::move((*src)[a++]);
-                else
-                    (*dst)[idx++] = std::move((*src)[b++]);
+bool generateRunsPipelined(const std::string& filename, int& totalRuns, const ExternalSortConfig& config = {},
+                           Compare comp = Compare()) {
+    MappedInput input = openInput(filename);
+    InputCursor in(input);
+
+    const size_t workers = std::max(1u, std::min(std::thread::hardware_concurrency(), max_threads));
+    const size_t buffers = workers + 2;
+    const std::uint64_t bufferBytes =
+        std::max<std::uint64_t>(config.memoryBudget / (buffers + workers), sizeof(T));
+    const RunFormat format = config.runFormat;
+
+    BoundedQueue<RunBatch<T>> freeQueue(buffers);
+    BoundedQueue<RunBatch<T>> sortQueue(buffers);
+    BoundedQueue<RunBatch<T>> writeQueue(buffers);
+    for (size_t i = 0; i < buffers; ++i) freeQueue.push({});
+
+    // Первая ошибка записи закрывает все очереди: чтение и сортировщики
+    // останавливаются, а не ждут писателя, который больше ничего не возьмёт
+    std::atomic<bool> writeFailed{false};
+    std::thread writer([&]() {
+        AsyncIO io(config.ioDepth);
+        while (auto batch = writeQueue.pop()) {
+            std::string path = filename + ".part" + std::to_string(batch->index);
+            if (!writeChunk<T>(path, batch->data, format, run_order_of<Compare>::value, &io)) {
+                std::cerr << "Ошибка записи: " << path << "\n";
+                writeFailed = true;
+                writeQueue.close();
+                sortQueue.close();
+                freeQueue.close();
+                return;
             }
-            while (a < mid) (*dst)[idx++] = std::move((*src)[a++]);
-            while (b < right) (*dst)[idx++] = std::move((*src)[b++]);
+            std::cout << "Отсортирован: " << path << " (" << batch->data.size() << " элементов)\n";
+            batch->data.clear();
+            freeQueue.push(std::move(*batch));
         }
-        std::swap(src, dst);
+    });
+
+    totalRuns = 0;
+    ThreadPool pool(workers);
+    TaskGroup sorters(pool);
+    for (size_t w = 0; w < workers; ++w) {
+        sorters.run([&sortQueue, &writeQueue, &freeQueue, comp, unique = config.unique]() {
+            try {
+                while (auto batch = sortQueue.pop()) {
+                    sortChunk<T, Compare>(batch->data, comp);
+                    if (unique) dropRepeats(batch->data, comp);
+                    writeQueue.push(std::move(*batch));
+                }
+            } catch (...) {
+                // Останавливаем чтение: буфер потерян, и конвейер мог бы встать
+                sortQueue.close();
+                freeQueue.close();
+                throw;
+            }
+        });
     }
-    return std::move(*src);
+
+    // Пустой batch — очередь свободных буферов закрыта после ошибки сортировщика
+    // или писателя
+    auto batch = freeQueue.pop();
+    if constexpr (is_number<T>) if (batch) batch->data.reserve(bufferBytes / sizeof(T));
+
+    T value;
+    std::uint64_t bytes = 0;
+    std::uint64_t fillStart = profiler::now();
+    auto parsed = [&]() {
+        profiler::record("chunk.parse", fillStart, batch->data.size());
+        profiler::add(Counter::ValuesParsed, batch->data.size());
+    };
+    while (batch && !writeFailed && readValue(in, value)) {
+        bytes += approxBytes(value);
+        batch->data.push_back(std::move(value));
+        if (bytes >= bufferBytes) {
+            parsed();
+            batch->index = totalRuns++;
+            sortQueue.push(std::move(*batch));
+            batch = freeQueue.pop();
+            if constexpr (is_number<T>) if (batch) batch->data.reserve(bufferBytes / sizeof(T));
+            bytes = 0;
+            fillStart = profiler::now();
+        }
+    }
+    if (batch && !writeFailed && !batch->data.empty()) {
+        parsed();
+        batch->index = totalRuns++;
+        sortQueue.push(std::move(*batch));
+    }
+    sortQueue.close();
+
+    // Сортировщики разбирают остаток очереди; писатель закрывается и при
+    // их ошибке, иначе он ждал бы очередь записи вечно
+    try {
+        sorters.wait();
+    } catch (...) {
+        writeQueue.close();
+        writer.join();
+        throw;
+    }
+    writeQueue.close();
+    writer.join();
+    if (writeFailed) return false;
+
+    std::cout << "Всего ранов: " << totalRuns << "\n";
+    return true;
 }
 
+// ---------- Выбор с замещением (replacement selection) ----------
+//
+// Куча на весь бюджет памяти. Из кучи всегда выводится наименьший элемент
+// текущего рана, на его место читается следующий элемент входа. Если он
+// меньше только что выведенного, то в текущий ран уже не попадёт и
+// помечается следующим номером рана. На случайных данных раны выходят около
+// двух бюджетов памяти, на почти отсортированных — один ран на весь файл.
+
+template<typename T>
+struct SelectionEntry {
+    std::uint32_t run;
+    T value;
+};
 
 template<typename T, typename Compare = std::less<T>>
-void processChunk(const std::string& path, Compare comp = Compare()) {
-    std::vector<T> data;
-    if (!readChunk<T>(path, data)) {
-        std::cerr << "Ошибка чтения: " << path << "\n";
-        return;
+bool generateRunsReplacement(const std::string& filename, int& totalRuns, const ExternalSortConfig& config = {},
+                             Compare comp = Compare()) {
+    MappedInput input = openInput(filename);
+    InputCursor in(input);
+
+    using Entry = SelectionEntry<T>;
+    // Вершина кучи — наименьший номер рана, внутри рана — первый по comp
+    auto after = [&comp](const Entry& a, const Entry& b) {
+        if (a.run != b.run) return a.run > b.run;
+        return comp(b.value, a.value);
+    };
+    auto entryBytes = [](const Entry& e) {
+        return approxBytes(e.value) + sizeof(Entry) - sizeof(T);
+    };
+
+    const std::uint64_t capacityBytes = std::max<std::uint64_t>(config.memoryBudget, sizeof(Entry));
+    std::vector<Entry> heap;
+    if constexpr (is_number<T>) heap.reserve(capacityBytes / sizeof(Entry));
+
+    std::uint64_t bytes = 0;
+    T value;
+    while (bytes < capacityBytes && readValue(in, value)) {
+        heap.push_back({0, std::move(value)});
+        bytes += entryBytes(heap.back());
     }
-    std::cout << "Чанк считан: " << path << " (" << data.size() << " элементов)\n";
+    std::make_heap(heap.begin(), heap.end(), after);
+
+    totalRuns = 0;
+    std::uint32_t currentRun = 0;
+    AsyncIO io(config.ioDepth);
+    std::unique_ptr<RunWriter<T>> out;
+    std::string path;
+    T last{};   // последнее записанное значение, нужно только для --unique
+
+    std::uint64_t runStart = 0, parsedValues = heap.size();
+    // false — ран не записан целиком, генерация прерывается
+    auto finishRun = [&]() {
+        if (!out) return true;
+        std::uint64_t count = out->count();
+        profiler::record("run.replacement", runStart, count);
+        const bool written = out->close();
+        out.reset();
+        if (!written) {
+            std::cerr << "Ошибка записи: " << path << "\n";
+            return false;
+        }
+        std::cout << "Отсортирован: " << path << " (" << count << " элементов)\n";
+        return true;
+    };
 
-    auto sorted = mergeSort<T, Compare>(std::move(data), comp);
+    bool inputLeft = true;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), after);
+        Entry top = std::move(heap.back());
+        heap.pop_back();
+        bytes -= entryBytes(top);
+
+        // С --unique значение, равное предыдущему в том же ране, пропускается
+        const bool repeat = config.unique && out && top.run == currentRun && !comp(last, top.value);
+        if (!out || top.run != currentRun) {
+            if (!finishRun()) return false;
+            currentRun = top.run;
+            runStart = profiler::now();
+            path = filename + ".part" + std::to_string(totalRuns++);
+            out = std::make_unique<RunWriter<T>>(path, config.runFormat, run_order_of<Compare>::value, 0, &io);
+            if (!out->ok()) {
+                std::cerr << "Ошибка: не удалось создать файл-чанк \"" << path << "\"\n";
+                return false;
+            }
+        }
+        if (!repeat) {
+            out->write(top.value);
+            if (config.unique) last = top.value;
+        }
 
-    if (!writeChunk<T>(path, sorted)) {
-        std::cerr << "Ошибка записи: " << path << "\n";
-    } else {
-        std::cout << "Отсортирован: " << path << "\n";
+        // Дочитываем вход, пока куча не заполнит бюджет снова
+        while (inputLeft && bytes < capacityBytes) {
+            if (!readValue(in, value)) {
+                inputLeft = false;
+                break;
+            }
+            ++parsedValues;
+            std::uint32_t run = comp(value, top.value) ? currentRun + 1 : currentRun;
+            heap.push_back({run, std::move(value)});
+            bytes += entryBytes(heap.back());
+            std::push_heap(heap.begin(), heap.end(), after);
+        }
     }
-}
+    if (!finishRun()) return false;
+    profiler::add(Counter::ValuesParsed, parsedValues);
 
-// ---------- Параллельная обработка чанков ----------
+    std::cout << "Всего ранов: " << totalRuns << "\n";
+    return true;
+}
 
+// Нарезает вход на раны filename.partN, их число — в runs. Если хоть один
+// ран не записан, уже записанные удаляются и возвращается false: сливать
+// неполный набор ранов нельзя
 template<typename T, typename Compare = std::less<T>>
-void sortAllChunks(const std::string& baseFilename, int totalChunks, Compare comp = Compare()) {
-    ThreadPool pool(std::min(std::thread::hardware_concurrency(), max_threads));
-    std::atomic<int> completed{0};
-    for (int i = 0; i < totalChunks; ++i) {
-        std::string chunk = baseFilename + ".part" + std::to_string(i);
-        pool.enqueue([chunk, &completed, comp]() mutable {
-            processChunk<T, Compare>(chunk, comp);
-            ++completed;
-        });
+bool generateSortedRuns(const std::string& filename, int& runs, const ExternalSortConfig& config = {},
+                        Compare comp = Compare()) {
+    const IOPhaseReport report("Генерация ранов", config);
+    profiler::ScopedTimer timer("phase.runs");
+    runs = 0;
+    bool ok;
+    if (config.runStrategy == RunStrategy::Replacement)
+        ok = generateRunsReplacement<T, Compare>(filename, runs, config, comp);
+    else if (config.pipeline)
+        ok = generateRunsPipelined<T, Compare>(filename, runs, config, comp);
+    else
+        ok = generateRuns<T, Compare>(filename, runs, config, comp);
+    if (!ok) {
+        std::cerr << "Ошибка генерации ранов, начатые раны удалены: " << filename << ".part*" << std::endl;
+        for (int i = 0; i < runs; ++i) std::remove((filename + ".part" + std::to_string(i)).c_str());
+        return false;
     }
-    while (completed < totalChunks) std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    std::cout << "Все чанки отсортированы." << std::endl;
+    // Раны пишутся в фоновых потоках, пока вход читается и сортируется
+    report.print("потокам записи ранов");
+    return true;
 }
 
 // Макрос для логирования
 #define LOG(x) std::cout << x << std::endl
 
-// ---------- Структура для кучи ----------
+// ---------- k-путевое слияние ----------
+
+// Сливает отсортированные раны деревом проигравших, каждое значение по
+// порядку передаётся в sink. Значения не копируются: голова каждого рана
+// живёт в heads и перечитывается на месте. С unique равные значения разных
+// ранов приходят подряд, и в sink уходит только первое из них; для этого
+// копия последнего выведенного значения хранится в last.
+//
+// Матчи дерева (их на каждое значение ровно глубина листа победителя) и
+// выданные значения копятся в локальных переменных и уходят в счётчики
+// профилировщика раз в MERGE_COUNTER_BATCH шагов: по ним же печатается
+// прогресс, так что в самом цикле нет ни вывода, ни атомиков.
+constexpr std::uint64_t MERGE_COUNTER_BATCH = 1 << 16;
+
+template<typename T, typename Compare, typename Sink>
+std::uint64_t mergeRuns(std::vector<RunReader<T>>& inputs, Sink&& sink, Compare comp, bool unique = false) {
+    const size_t k = inputs.size();
+    // Первые блоки всех ранов читаются одновременно
+    for (auto& input : inputs) input.prefetch();
+    std::vector<T> heads(k);
+    std::vector<char> alive(k);
+    for (size_t i = 0; i < k; ++i)
+        alive[i] = inputs[i].next(heads[i]);
+
+    LoserTree<T, Compare> tree(heads, alive, comp);
+    std::vector<std::uint8_t> depth(k);
+    for (size_t i = 0; i < k; ++i) depth[i] = static_cast<std::uint8_t>(std::bit_width(i + k) - 1);
+
+    std::uint64_t written = 0, reported = 0, comparisons = 0, steps = 0;
+    auto flushCounters = [&]() {
+        profiler::add(Counter::MergeComparisons, comparisons);
+        profiler::add(Counter::MergedValues, written - reported);
+        comparisons = 0;
+        reported = written;
+    };
+    T last{};
+    while (!tree.empty()) {
+        const size_t w = tree.winner();
+        if (!unique || written == 0 || comp(last, heads[w])) {
+            sink(heads[w]);
+            ++written;
+            if (unique) last = heads[w];
+        }
+        alive[w] = inputs[w].next(heads[w]);
+        comparisons += depth[w];
+        tree.replay();
+        if (++steps % MERGE_COUNTER_BATCH == 0) flushCounters();
+    }
+    flushCounters();
+    return written;
+}
 
+// Все ли раны дочитаны без ошибок. Слияние видит неудачное или короткое
+// чтение как конец рана, поэтому проверять нужно после каждого слияния
 template<typename T>
-struct HeapNode {
-    T value;
-    size_t chunkIndex;
+bool runsReadOk(const std::vector<RunReader<T>>& inputs) {
+    return std::all_of(inputs.begin(), inputs.end(), [](const RunReader<T>& input) { return input.ok(); });
+}
+
+// Размер блока упреждающего чтения на один ран: весь блоковый буфер слияния
+// должен уместиться в бюджет памяти
+inline std::size_t mergeReadBlock(const ExternalSortConfig& config, size_t runs) {
+    return static_cast<std::size_t>(
+        std::min<std::uint64_t>(config.readBlockBytes, config.memoryBudget / (runs + 1)));
+}
+
+// Вывод значения в итоговый файл по умолчанию — как есть
+struct WriteValue {
+    template<typename T>
+    void operator()(OutputWriter& out, const T& value) const { out.write(value); }
 };
 
-template<typename T, typename Compare = std::less<T>>
-bool mergeChunksToFile(const std::string& baseFilename,
-                       int totalChunks,
-                       const std::string& outFile,
-                       Compare comp = Compare()) {
-    using Node = HeapNode<T>;
-    auto cmp = [&](const Node& a, const Node& b) { return comp(b.value, a.value); };
-    std::priority_queue<Node, std::vector<Node>, decltype(cmp)> heap(cmp);
+// Сливает inputs в текстовый файл через буфер записи bufferBytes; emit
+// выводит каждое значение (например, собирает запись по её ключу)
+template<typename T, typename Compare, typename Emit = WriteValue>
+bool mergeRunsToText(std::vector<RunReader<T>>& inputs, const std::string& outFile,
+                     std::uint64_t bufferBytes, Compare comp, std::uint64_t& written,
+                     bool unique, AsyncIO* io = nullptr, const Emit& emit = Emit()) {
+    OutputWriter out(outFile, static_cast<size_t>(bufferBytes), io);
+    if (!out.ok()) { std::cerr << "Не удалось открыть выходной файл: " << outFile << std::endl; return false; }
+
+    // Итоговый текст форматируется ровно один раз — здесь
+    written = mergeRuns<T>(inputs, [&](const T& value) { emit(out, value); }, comp, unique);
+    if (!runsReadOk(inputs)) {
+        std::cerr << "Ошибка чтения рана при слиянии в " << outFile << std::endl;
+        out.close();
+        return false;
+    }
+    return out.close();
+}
 
-    std::vector<std::ifstream> inputs(totalChunks);
-    std::vector<bool> alive(totalChunks, true);
-    std::vector<std::string> names(totalChunks);
+// ---------- Параллельное слияние по диапазонам ключей ----------
+//
+// Диапазон ключей делится на P частей сплиттерами, выбранными по равномерной
+// выборке из всех ранов (каждый отсчёт представляет одинаковое число
+// элементов). В каждом бинарном ране бинарным поиском находится граница
+// каждого сплиттера, после чего поток p сливает свои диапазоны всех ранов в
+// отдельный сегмент outFile.segP. Значения, равные сплиттеру, во всех ранах
+// уходят в правую часть, а внутри части равные идут по номеру рана, поэтому
+// склейка сегментов побайтно совпадает с последовательным слиянием. По той
+// же причине все повторы значения попадают в один сегмент, и --unique
+// работает внутри сегментов.
+
+// Первая позиция в ране, чьё значение не идёт раньше key
+template<typename T, typename Compare>
+std::uint64_t runLowerBound(RunReader<T>& run, const T& key, Compare comp) {
+    std::uint64_t lo = 0, hi = run.size();
+    T value;
+    while (lo < hi) {
+        std::uint64_t mid = lo + (hi - lo) / 2;
+        if (run.readAt(mid, value) && comp(value, key)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
 
-    // Инициализация
-    for (int i = 0; i < totalChunks; ++i) {
-        names[i] = baseFilename + ".part" + std::to_string(i);
-        inputs[i].open(names[i]);
-        if (!inputs[i]) {
-            std::cerr << "не удалось открыть: " << names[i] << std::endl;
+// Дописывает файлы по порядку в outFile; на Linux — copy_file_range без
+// копирования через пространство пользователя
+inline bool concatFiles(const std::vector<std::string>& parts, const std::string& outFile) {
+    int out = ::open(outFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) return false;
+    bool ok = true;
+    std::vector<char> buffer;
+    for (const auto& part : parts) {
+        int in = ::open(part.c_str(), O_RDONLY);
+        struct stat st{};
+        if (in < 0 || ::fstat(in, &st) != 0) { ok = false; if (in >= 0) ::close(in); break; }
+        off_t left = st.st_size;
+#ifdef __linux__
+        while (left > 0) {
+            ssize_t n = ::copy_file_range(in, nullptr, out, nullptr, static_cast<size_t>(left), 0);
+            if (n <= 0) break;   // не поддерживается этой ФС — докопируем вручную
+            left -= n;
+        }
+#endif
+        if (left > 0) buffer.resize(1 << 20);
+        while (left > 0) {
+            ssize_t n = ::read(in, buffer.data(), buffer.size());
+            if (n <= 0 || ::write(out, buffer.data(), static_cast<size_t>(n)) != n) { ok = false; break; }
+            left -= n;
+        }
+        ::close(in);
+        if (!ok) break;
+    }
+    return ::close(out) == 0 && ok;
+}
+
+template<typename T, typename Compare>
+bool mergeChunksToFileParallel(const std::vector<std::string>& names,
+                               const std::string& outFile,
+                               const ExternalSortConfig& config,
+                               size_t threads,
+                               Compare comp,
+                               std::uint64_t& totalWritten) {
+    const size_t k = names.size();
+
+    // Размеры ранов и равномерная выборка для сплиттеров
+    std::vector<RunReader<T>> probes(k);
+    std::uint64_t total = 0;
+    for (size_t r = 0; r < k; ++r) {
+        if (!probes[r].open(names[r], RunFormat::Binary)) {
+            std::cerr << "не удалось открыть: " << names[r] << std::endl;
+            return false;
+        }
+        total += probes[r].size();
+    }
+    const std::uint64_t stride = std::max<std::uint64_t>(1, total / (threads * 256));
+    std::vector<T> samples;
+    for (size_t r = 0; r < k; ++r) {
+        T value;
+        for (std::uint64_t i = stride / 2; i < probes[r].size(); i += stride)
+            if (probes[r].readAt(i, value)) samples.push_back(value);
+    }
+    std::sort(samples.begin(), samples.end(), comp);
+
+    std::vector<T> splitters;
+    for (size_t p = 1; p < threads && !samples.empty(); ++p)
+        splitters.push_back(samples[p * samples.size() / threads]);
+    const size_t segments = splitters.size() + 1;
+
+    // bounds[r][p] — начало диапазона сегмента p в ране r
+    std::vector<std::vector<std::uint64_t>> bounds(k, std::vector<std::uint64_t>(segments + 1));
+    for (size_t r = 0; r < k; ++r) {
+        bounds[r][0] = 0;
+        for (size_t p = 1; p < segments; ++p)
+            bounds[r][p] = runLowerBound(probes[r], splitters[p - 1], comp);
+        bounds[r][segments] = probes[r].size();
+        if (!probes[r].ok()) {
+            std::cerr << "Ошибка чтения рана: " << names[r] << std::endl;
             return false;
         }
-        std::string line;
-        if (std::getline(inputs[i], line) && !line.empty()) {
-            std::istringstream iss(line);
-            T val;
-            if constexpr (is_number<T>) iss >> val, heap.push({val, (size_t)i});
-            else heap.push({line, (size_t)i});
-        } else alive[i] = false;
+        probes[r].close();
+    }
+    std::cout << "Параллельное слияние: " << segments << " сегментов, " << k << " ранов\n";
+
+    const std::size_t blockBytes = mergeReadBlock(config, k * segments);
+    std::vector<std::string> segmentNames(segments);
+    std::vector<std::uint64_t> segmentCounts(segments, 0);
+    std::vector<char> segmentOk(segments, 0);
+
+    for (size_t p = 0; p < segments; ++p)
+        segmentNames[p] = outFile + ".seg" + std::to_string(p);
+
+    ThreadPool pool(segments);
+    pool.parallel_for(0, segments, 1, [&](size_t p) {
+        profiler::ScopedTimer timer("merge.segment", p);
+        AsyncIO io(config.ioDepth);
+        std::vector<RunReader<T>> inputs(k);
+        for (size_t r = 0; r < k; ++r) {
+            if (!inputs[r].open(names[r], RunFormat::Binary, blockBytes, &io) ||
+                !inputs[r].seekRange(bounds[r][p], bounds[r][p + 1] - bounds[r][p])) {
+                std::cerr << "не удалось открыть: " << names[r] << std::endl;
+                return;
+            }
+        }
+        segmentOk[p] = mergeRunsToText<T>(inputs, segmentNames[p], config.writeBufferBytes / segments,
+                                          comp, segmentCounts[p], config.unique, &io);
+    });
+
+    bool ok = std::all_of(segmentOk.begin(), segmentOk.end(), [](char c) { return c != 0; }) &&
+              concatFiles(segmentNames, outFile);
+    for (const auto& segment : segmentNames) std::remove(segment.c_str());
+    totalWritten = 0;
+    for (auto count : segmentCounts) totalWritten += count;
+    if (!ok) std::cerr << "Ошибка параллельного слияния в " << outFile << std::endl;
+    return ok;
+}
+
+// ---------- Многопроходное слияние ----------
+//
+// При тысячах ранов слияние за один проход открыло бы тысячи файлов, и на
+// каждый пришлось бы по крошечному блоку чтения. Планировщик ограничивает
+// fan-in так, чтобы блок на ран был не меньше MIN_MERGE_BLOCK и хватало
+// дескрипторов файлов, и выравнивает его: при P проходах берётся наименьший
+// fan-in F с F^P >= числа ранов. Промежуточные проходы сливают группы по F
+// ранов в новые раны параллельно на ThreadPool; группы идут по порядку
+// номеров ранов, так что равные значения остаются в том же порядке, что и
+// при слиянии за один проход.
+
+constexpr std::uint64_t MIN_MERGE_BLOCK = 256 * 1024;
+
+struct MergePlan {
+    size_t fanIn;
+    size_t passes;
+};
+
+// threads — сколько слияний идёт одновременно на последнем проходе
+inline MergePlan planMerge(size_t runs, const ExternalSortConfig& config, size_t threads) {
+    std::uint64_t limit = config.maxFanIn
+        ? config.maxFanIn
+        : std::max<std::uint64_t>(2, config.memoryBudget / (MIN_MERGE_BLOCK * threads));
+    struct rlimit fileLimit{};
+    if (::getrlimit(RLIMIT_NOFILE, &fileLimit) == 0 && fileLimit.rlim_cur != RLIM_INFINITY &&
+        fileLimit.rlim_cur > 32)
+        limit = std::min<std::uint64_t>(limit, (fileLimit.rlim_cur - 16) / threads);
+    limit = std::max<std::uint64_t>(limit, 2);
+
+    size_t passes = 1;
+    for (std::uint64_t capacity = limit; capacity < runs; capacity *= limit)
+        ++passes;
+
+    std::uint64_t fanIn = 2;
+    auto reaches = [&](std::uint64_t f) {
+        std::uint64_t capacity = 1;
+        for (size_t p = 0; p < passes && capacity < runs; ++p) capacity *= f;
+        return capacity >= runs;
+    };
+    while (fanIn < limit && !reaches(fanIn)) ++fanIn;
+    return {static_cast<size_t>(fanIn), passes};
+}
+
+// Один промежуточный проход: группы по fanIn ранов сливаются в новые раны.
+// Если группа не открыла или не дочитала ран или не дописала выход, её
+// входные раны не удаляются, а проход возвращает nullopt
+template<typename T, typename Compare>
+std::optional<std::vector<std::string>> mergePass(const std::vector<std::string>& names,
+                                   const std::string& baseFilename,
+                                   size_t pass, size_t fanIn,
+                                   const ExternalSortConfig& config, Compare comp) {
+    const size_t groups = (names.size() + fanIn - 1) / fanIn;
+    const size_t workers = std::min<size_t>(groups,
+        std::max(1u, std::min(std::thread::hardware_concurrency(), max_threads)));
+    const std::size_t blockBytes = mergeReadBlock(config, workers * (fanIn + 1));
+    const std::uint64_t writeBytes = std::max<std::uint64_t>(blockBytes, MIN_MERGE_BLOCK);
+
+    std::vector<std::string> outputs(groups);
+    std::vector<char> groupOk(groups, 0);
+    for (size_t g = 0; g < groups; ++g)
+        outputs[g] = baseFilename + ".pass" + std::to_string(pass) + ".part" + std::to_string(g);
+
+    ThreadPool pool(workers);
+    pool.parallel_for(0, groups, 1, [&](size_t g) {
+        const size_t first = g * fanIn;
+        const size_t last = std::min(names.size(), first + fanIn);
+        profiler::ScopedTimer timer("merge.group", g);
+        AsyncIO io(config.ioDepth);
+        std::vector<RunReader<T>> inputs(last - first);
+        for (size_t r = first; r < last; ++r) {
+            if (!inputs[r - first].open(names[r], config.runFormat, blockBytes, &io)) {
+                std::cerr << "не удалось открыть: " << names[r] << std::endl;
+                return;
+            }
+        }
+
+        RunWriter<T> out(outputs[g], config.runFormat, run_order_of<Compare>::value, writeBytes, &io);
+        mergeRuns<T>(inputs, [&](const T& value) { out.write(value); }, comp, config.unique);
+        if (!runsReadOk(inputs)) {
+            std::cerr << "Ошибка чтения ранов " << names[first] << " .. " << names[last - 1] << std::endl;
+            out.close();
+            std::remove(outputs[g].c_str());
+            return;
+        }
+        for (auto& input : inputs) input.close();
+        if (!out.close()) {
+            std::cerr << "Ошибка записи: " << outputs[g] << std::endl;
+            std::remove(outputs[g].c_str());
+            return;
+        }
+        groupOk[g] = 1;
+        for (size_t r = first; r < last; ++r) std::remove(names[r].c_str());
+    });
+    if (!std::all_of(groupOk.begin(), groupOk.end(), [](char c) { return c != 0; })) {
+        std::cerr << "Ошибка прохода слияния " << pass << ", раны не удалены" << std::endl;
+        return std::nullopt;
     }
+    LOG("Проход " << pass << ": " << names.size() << " ранов -> " << groups);
+    return outputs;
+}
 
-    std::ofstream out(outFile);
-    if (!out) { std::cerr << "Не удалось открыть выходной файл: " << outFile << std::endl; return false; }
+template<typename T, typename Compare = std::less<T>, typename Emit = WriteValue>
+bool mergeChunksToFile(const std::string& baseFilename,
+                       int totalChunks,
+                       const std::string& outFile,
+                       const ExternalSortConfig& config = {},
+                       Compare comp = Compare(),
+                       const Emit& emit = Emit()) {
+    std::vector<std::string> names(totalChunks);
+    for (int i = 0; i < totalChunks; ++i)
+        names[i] = baseFilename + ".part" + std::to_string(i);
 
-    // Если T — плавающий, настраиваем фиксированный формат и максимальную точность
-    if constexpr (std::is_floating_point_v<T>) {
-        out << std::fixed
-            << std::setprecision(std::numeric_limits<T>::max_digits10);
+    // Параллельное слияние ищет границы по номеру значения — только бинарные раны
+    size_t threads = config.mergeThreads ? config.mergeThreads
+                                         : std::max(1u, std::min(std::thread::hardware_concurrency(), max_threads));
+    if (threads > 1 && !(is_number<T> && config.runFormat == RunFormat::Binary &&
+                         std::is_same_v<Emit, WriteValue>)) {
+        std::cout << "Параллельное слияние доступно только для бинарных ранов, сливаем в один поток\n";
+        threads = 1;
     }
 
+    const IOPhaseReport report("Слияние", config);
+    profiler::ScopedTimer timer("phase.merge");
+    // Прогресс печатается раз в секунду по счётчику слияний
+    ProgressReporter progress("Прогресс: ", Counter::MergedValues);
+    const MergePlan plan = planMerge(names.size(), config, threads);
+    LOG("План слияния: " << names.size() << " ранов, проходов: " << plan.passes
+        << ", fan-in: " << plan.fanIn);
+    for (size_t pass = 1; pass < plan.passes; ++pass) {
+        auto merged = mergePass<T>(names, baseFilename, pass, plan.fanIn, config, comp);
+        if (!merged) return false;   // раны остаются на диске, сообщение уже напечатано
+        names = std::move(*merged);
+    }
+    totalChunks = static_cast<int>(names.size());
 
-    size_t written = 0;
-    while (!heap.empty()) {
-        auto cur = heap.top(); heap.pop();
-        out << cur.value << "\n";
-        ++written;
-        if (written % 1'000'000 == 0) LOG("Прогресс: " << written);
-
-        size_t idx = cur.chunkIndex;
-        if (!alive[idx]) continue;
-
-        std::string line;
-        if (std::getline(inputs[idx], line) && !line.empty()) {
-            std::istringstream iss(line);
-            T val;
-            if constexpr (is_number<T>) {
-                if (!(iss >> val)) { std::cerr << "Ошибка парсинга в " << names[idx] << std::endl; }
-                else heap.push({val, idx});
-            } else {
-                heap.push({line, idx});
+    bool ok = true;
+    std::uint64_t written = 0;
+    if (threads > 1 && totalChunks > 0) {
+        if constexpr (is_number<T> && std::is_same_v<Emit, WriteValue>) {
+            ok = mergeChunksToFileParallel<T>(names, outFile, config, threads, comp, written);
+        }
+    } else {
+        AsyncIO io(config.ioDepth);
+        std::vector<RunReader<T>> inputs(totalChunks);
+        const std::size_t blockBytes = mergeReadBlock(config, totalChunks);
+
+        // Инициализация
+        for (int i = 0; i < totalChunks; ++i) {
+            if (!inputs[i].open(names[i], config.runFormat, blockBytes, &io)) {
+                std::cerr << "не удалось открыть: " << names[i] << std::endl;
+                return false;
+            }
+            if (config.runFormat == RunFormat::Binary && is_number<T> &&
+                inputs[i].order() != run_order_of<Compare>::value) {
+                std::cerr << "⚠️ Порядок рана " << names[i] << " не совпадает с порядком слияния" << std::endl;
             }
-        } else {
-            inputs[idx].close();
-            alive[idx] = false;
-            if (std::remove(names[idx].c_str()) != 0)
-                std::cerr << "⚠️ Не удалось удалить " << names[idx] << std::endl;
-            else LOG("Удалён: " << names[idx]);
         }
+
+        ok = mergeRunsToText<T>(inputs, outFile, config.writeBufferBytes, comp, written, config.unique, &io, emit);
+        for (auto& input : inputs) input.close();
+    }
+
+    // Раны нужны, пока результат не записан целиком
+    if (!ok) {
+        if (names.empty())
+            std::cerr << "Слияние не завершено: " << outFile << std::endl;
+        else
+            std::cerr << "Слияние не завершено, раны оставлены: " << names.front() << " и далее" << std::endl;
+        return false;
+    }
+    for (const auto& name : names) {
+        if (std::remove(name.c_str()) != 0)
+            std::cerr << "⚠️ Не удалось удалить " << name << std::endl;
+        else LOG("Удалён: " << name);
     }
     LOG("Слияние завершено: " << outFile << " (" << written << " строк)");
-    return true;
+    report.print(threads > 1 || plan.passes > 1 ? "потокам слияния" : nullptr);
+    return ok;
 }
-
@@ -1,45 +1,154 @@
+#pragma once
+
 #include <iostream>
 #include <vector>
-#include <stack>
 #include <string>
 #include <functional>
 #include <iomanip>
 #include <limits>
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+#include "WorkStealingPool.hpp"
+
+
+// ---------- Быстрая сортировка в памяти (интроспективная) ----------
+//
+// Опорный элемент — медиана трёх, на больших диапазонах — ninther (медиана
+// трёх медиан), поэтому уже отсортированный и обратный вход делится пополам.
+// Разбиение Хоара: оба указателя останавливаются на равных опорному, так что
+// повторяющиеся значения тоже делятся поровну. Короткие диапазоны досортировываются
+// вставками, при слишком глубокой рекурсии диапазон уходит в пирамидальную
+// сортировку — худший случай O(n log n). Индексы size_t, диапазоны полуоткрытые.
+//
+// Параллельная версия отдаёт меньшую половину разбиения в WorkStealingPool,
+// если она не меньше QUICK_SORT_GRAIN, а большую продолжает сама.
+
+constexpr size_t INSERTION_SORT_THRESHOLD = 24;
+constexpr size_t NINTHER_THRESHOLD = 128;
+constexpr size_t QUICK_SORT_GRAIN = 1 << 14;
+
+template<typename T, typename Compare>
+void insertionSort(std::vector<T>& arr, size_t low, size_t high, Compare comp) {
+    for (size_t i = low + 1; i < high; ++i) {
+        if (!comp(arr[i], arr[i - 1])) continue;
+        T value = std::move(arr[i]);
+        size_t j = i;
+        do {
+            arr[j] = std::move(arr[j - 1]);
+            --j;
+        } while (j > low && comp(value, arr[j - 1]));
+        arr[j] = std::move(value);
+    }
+}
+
+template<typename T, typename Compare>
+void heapSort(std::vector<T>& arr, size_t low, size_t high, Compare comp) {
+    std::make_heap(arr.begin() + low, arr.begin() + high, comp);
+    std::sort_heap(arr.begin() + low, arr.begin() + high, comp);
+}
+
+template<typename T, typename Compare>
+size_t medianOfThree(const std::vector<T>& arr, size_t a, size_t b, size_t c, Compare comp) {
+    if (comp(arr[a], arr[b])) {
+        if (comp(arr[b], arr[c])) return b;
+        return comp(arr[a], arr[c]) ? c : a;
+    }
+    if (comp(arr[a], arr[c])) return a;
+    return comp(arr[b], arr[c]) ? c : b;
+}
 
+template<typename T, typename Compare>
+size_t choosePivot(const std::vector<T>& arr, size_t low, size_t high, Compare comp) {
+    const size_t n = high - low;
+    const size_t mid = low + n / 2;
+    if (n < NINTHER_THRESHOLD)
+        return medianOfThree(arr, low, mid, high - 1, comp);
+    const size_t step = n / 8;
+    return medianOfThree(arr,
+        medianOfThree(arr, low, low + step, low + 2 * step, comp),
+        medianOfThree(arr, mid - step, mid, mid + step, comp),
+        medianOfThree(arr, high - 1 - 2 * step, high - 1 - step, high - 1, comp),
+        comp);
+}
+
+// Разбиение Хоара вокруг arr[low]; возвращает итоговую позицию опорного p:
+// [low, p) не больше опорного, (p, high) не меньше
+template<typename T, typename Compare>
+size_t hoarePartition(std::vector<T>& arr, size_t low, size_t high, Compare comp) {
+    std::swap(arr[low], arr[choosePivot(arr, low, high, comp)]);
+    const T& pivot = arr[low];   // не двигается до последнего обмена
+    size_t i = low, j = high;
+    while (true) {
+        while (++i < high && comp(arr[i], pivot)) {}
+        while (comp(pivot, arr[--j])) {}   // arr[low] — ограничитель
+        if (i >= j) break;
+        std::swap(arr[i], arr[j]);
+    }
+    std::swap(arr[low], arr[j]);
+    return j;
+}
+
+inline unsigned introsortDepth(size_t n) {
+    unsigned depth = 0;
+    while (n > 1) { n >>= 1; depth += 2; }
+    return depth;
+}
 
+// Сортирует [low, high): меньшая часть — рекурсией или задачей пула,
+// большая — в цикле, так что глубина стека не больше log2(n)
 template<typename T, typename Compare>
-int partition(std::vector<T>& arr, int low, int high, Compare comp) {
-    T pivot = arr[high];
-    int i = low - 1;
-
-    for (int j = low; j < high; ++j) {
-        if (comp(arr[j], pivot)) {
-            ++i;
-            std::swap(arr[i], arr[j]);
+void introSortRange(std::vector<T>& arr, size_t low, size_t high, unsigned depth, Compare comp,
+                    WorkStealingPool* pool = nullptr, WorkStealingPool::Group* group = nullptr) {
+    while (high - low > INSERTION_SORT_THRESHOLD) {
+        if (depth == 0) {
+            heapSort(arr, low, high, comp);
+            return;
+        }
+        --depth;
+
+        const size_t p = hoarePartition(arr, low, high, comp);
+        size_t smallLow = low, smallHigh = p;
+        if (p - low > high - (p + 1)) {
+            smallLow = p + 1;
+            smallHigh = high;
+            high = p;
+        } else {
+            low = p + 1;
+        }
+
+        if (pool && smallHigh - smallLow >= QUICK_SORT_GRAIN) {
+            pool->spawn(*group, [&arr, smallLow, smallHigh, depth, comp, pool, group]() {
+                introSortRange(arr, smallLow, smallHigh, depth, comp, pool, group);
+            });
+        } else {
+            introSortRange(arr, smallLow, smallHigh, depth, comp);
         }
     }
+    insertionSort(arr, low, high, comp);
+}
 
-    std::swap(arr[i + 1], arr[high]);
-    return i + 1;
+template<typename T, typename Compare = std::less<T>>
+void quickSort(std::vector<T>& arr, Compare comp = Compare()) {
+    introSortRange(arr, 0, arr.size(), introsortDepth(arr.size()), comp);
 }
 
+// Все задачи сортировки порождаются в одну группу: счётчик группы растёт
+// раньше, чем завершается породившая задача, поэтому wait() вернётся только
+// после последнего диапазона
 template<typename T, typename Compare = std::less<T>>
-void quickSort(std::vector<T>& arr, int low, int high, Compare comp = Compare()) {
-    std::stack<std::pair<int, int>> stack;
-    stack.push({low, high});
-
-    while (!stack.empty()) {
-        auto [l, h] = stack.top();
-        stack.pop();
-
-        if (l < h) {
-            int p = partition(arr, l, h, comp);
-            if (p + 1 < h)
-                stack.push({p + 1, h});
-            if (l < p - 1)
-                stack.push({l, p - 1});
-        }
+void parallelQuickSort(std::vector<T>& arr, WorkStealingPool& pool, Compare comp = Compare()) {
+    const size_t n = arr.size();
+    if (pool.size() < 2 || n < 2 * QUICK_SORT_GRAIN) {
+        quickSort(arr, comp);
+        return;
     }
+    WorkStealingPool::Group group;
+    pool.spawn(group, [&arr, n, comp, &pool, &group]() {
+        introSortRange(arr, 0, n, introsortDepth(n), comp, &pool, &group);
+    });
+    pool.wait(group);
 }
 
 template<typename T>
@@ -48,4 +157,3 @@ void printVector(const std::vector<T>& arr) {
         std::cout << el << " ";
     std::cout << "\n";
 }
-
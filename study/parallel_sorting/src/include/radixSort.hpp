@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+
+// ---------- Поразрядная сортировка (LSD) ----------
+//
+// Для чисел фиксированной ширины. Значение отображается в беззнаковый ключ
+// той же ширины, порядок которого совпадает с порядком значений: у целых
+// инвертируется знаковый бит, у плавающей точки отрицательные инвертируются
+// целиком, а у положительных выставляется знаковый бит. Убывание — это
+// инверсия ключа, компаратор не нужен. Ключи пишутся прямо на место значений
+// (через memcpy, без нарушения алиасинга), так что дополнительная память —
+// один буфер размером с массив, как у mergeSort.
+//
+// Проходы по 8 бит, от младшего разряда. Проход, в котором у всех ключей
+// одинаковый разряд, пропускается. С пулом массив режется на блоки по числу
+// воркеров: каждый блок считает свою гистограмму, из гистограмм всех блоков
+// складываются смещения, и блоки раскладывают свои элементы параллельно;
+// порядок внутри блока сохраняется, поэтому сортировка устойчива.
+
+template<typename T>
+using RadixKey = std::conditional_t<sizeof(T) == 8, std::uint64_t,
+                 std::conditional_t<sizeof(T) == 4, std::uint32_t,
+                 std::conditional_t<sizeof(T) == 2, std::uint16_t, std::uint8_t>>>;
+
+constexpr size_t RADIX_BITS = 8;
+constexpr size_t RADIX_BUCKETS = size_t{1} << RADIX_BITS;
+constexpr size_t RADIX_PARALLEL_MIN = 1 << 16;   // меньше — один блок
+
+template<typename T>
+RadixKey<T> toRadixKey(T value, bool descending) {
+    using U = RadixKey<T>;
+    constexpr U sign = U(1) << (sizeof(U) * 8 - 1);
+    U bits;
+    std::memcpy(&bits, &value, sizeof(U));
+    if constexpr (std::is_floating_point_v<T>) bits = (bits & sign) ? U(~bits) : U(bits | sign);
+    else if constexpr (std::is_signed_v<T>) bits ^= sign;
+    return descending ? U(~bits) : bits;
+}
+
+template<typename T>
+T fromRadixKey(RadixKey<T> bits, bool descending) {
+    using U = RadixKey<T>;
+    constexpr U sign = U(1) << (sizeof(U) * 8 - 1);
+    if (descending) bits = U(~bits);
+    if constexpr (std::is_floating_point_v<T>) bits = (bits & sign) ? U(bits ^ sign) : U(~bits);
+    else if constexpr (std::is_signed_v<T>) bits ^= sign;
+    T value;
+    std::memcpy(&value, &bits, sizeof(U));
+    return value;
+}
+
+// pool == nullptr — в вызывающем потоке. Вызывать с пулом из задачи этого же
+// пула нельзя (см. ThreadPool::parallel_for). scratch — второй буфер
+// вызывающего, переживающий вызов: после сортировки он может поменяться с
+// data местами, но его ёмкость не теряется. Без него буфер выделяется заново.
+template<typename T>
+void radixSort(std::vector<T>& data, bool descending = false, ThreadPool* pool = nullptr,
+               std::vector<T>* scratch = nullptr) {
+    static_assert(std::is_arithmetic_v<T>, "radixSort работает только с числами");
+    using U = RadixKey<T>;
+    using Histogram = std::array<size_t, RADIX_BUCKETS>;
+    constexpr size_t passes = sizeof(U) * 8 / RADIX_BITS;
+
+    const size_t n = data.size();
+    if (n < 2) return;
+
+    const size_t blocks = pool && n >= RADIX_PARALLEL_MIN ? std::max<size_t>(pool->size(), 1) : 1;
+    auto blockBegin = [n, blocks](size_t b) { return n / blocks * b + std::min(b, n % blocks); };
+    auto forEachBlock = [&](auto&& fn) {
+        if (blocks == 1) fn(0);
+        else pool->parallel_for(0, blocks, 1, fn);
+    };
+    auto load = [](const T* slot) { U key; std::memcpy(&key, slot, sizeof(U)); return key; };
+    auto store = [](T* slot, U key) { std::memcpy(slot, &key, sizeof(U)); };
+    auto digit = [](U key, size_t pass) { return static_cast<size_t>(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1); };
+
+    // Первый проход: значения -> ключи и гистограммы всех разрядов сразу,
+    // чтобы знать, какие проходы можно пропустить
+    std::vector<std::array<Histogram, passes>> counts(blocks);
+    forEachBlock([&](size_t b) {
+        auto& hist = counts[b];
+        for (auto& h : hist) h.fill(0);
+        T* slots = data.data();
+        for (size_t i = blockBegin(b), end = blockBegin(b + 1); i < end; ++i) {
+            const U key = toRadixKey(slots[i], descending);
+            store(slots + i, key);
+            for (size_t p = 0; p < passes; ++p) ++hist[p][digit(key, p)];
+        }
+    });
+
+    std::vector<T> own;
+    std::vector<T>& buffer = scratch ? *scratch : own;
+    buffer.resize(n);
+    T* src = data.data();
+    T* dst = buffer.data();
+    std::vector<Histogram> blockHist(blocks);
+    std::vector<Histogram> offsets(blocks);
+
+    for (size_t pass = 0; pass < passes; ++pass) {
+        Histogram total{};
+        for (size_t b = 0; b < blocks; ++b)
+            for (size_t d = 0; d < RADIX_BUCKETS; ++d) total[d] += counts[b][pass][d];
+        if (std::find(total.begin(), total.end(), n) != total.end())
+            continue;
+
+        // Гистограммы блоков для текущей раскладки; на первом проходе уже есть
+        if (pass == 0) {
+            for (size_t b = 0; b < blocks; ++b) blockHist[b] = counts[b][0];
+        } else {
+            forEachBlock([&](size_t b) {
+                Histogram& h = blockHist[b];
+                h.fill(0);
+                for (size_t i = blockBegin(b), end = blockBegin(b + 1); i < end; ++i)
+                    ++h[digit(load(src + i), pass)];
+            });
+        }
+
+        // Смещение блока b в корзине d: все меньшие корзины плюс доля
+        // предыдущих блоков в этой корзине
+        size_t position = 0;
+        for (size_t d = 0; d < RADIX_BUCKETS; ++d)
+            for (size_t b = 0; b < blocks; ++b) {
+                offsets[b][d] = position;
+                position += blockHist[b][d];
+            }
+
+        forEachBlock([&](size_t b) {
+            Histogram& next = offsets[b];
+            for (size_t i = blockBegin(b), end = blockBegin(b + 1); i < end; ++i) {
+                const U key = load(src + i);
+                store(dst + next[digit(key, pass)]++, key);
+            }
+        });
+        std::swap(src, dst);
+    }
+
+    if (src != data.data()) data.swap(buffer);
+    forEachBlock([&](size_t b) {
+        T* slots = data.data();
+        for (size_t i = blockBegin(b), end = blockBegin(b + 1); i < end; ++i)
+            slots[i] = fromRadixKey<T>(load(slots + i), descending);
+    });
+}
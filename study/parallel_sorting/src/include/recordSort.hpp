@@ -0,0 +1,252 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MappedInput.hpp"
+#include "OutputWriter.hpp"
+#include "radixSort.hpp"
+#include "stringSort.hpp"
+#include "topSelect.hpp"
+#include "WorkStealingPool.hpp"
+
+
+// ---------- Сортировка записей по ключевым колонкам ----------
+//
+// Запись — строка входа (CSV/TSV), колонки разделены одним символом,
+// кавычки не разбираются. Ключ задаётся как в sort(1): "-k 2n,1s" — сначала
+// колонка 2 как число, затем колонка 1 как строка; суффикс r обращает
+// порядок колонки. Колонки нумеруются с 1.
+//
+// Сама запись при сортировке не двигается. Для каждой строится компактный
+// ключ — байтовая строка, чей лексикографический порядок совпадает с
+// порядком записей:
+//   число  — байт-метка (нет/не число < есть) и 8 байт toRadixKey<double>
+//            big-endian;
+//   строка — байты колонки, 0x00 экранируется как 00 FF, конец — 00 01;
+//   r      — все байты колонки инвертируются: набор кодов остаётся
+//            беспрефиксным, а порядок обращается.
+// Затем байты 0x0A и 0x0B экранируются (0B 01, 0B 02) — порядок сохраняется,
+// а ключ можно хранить строкой текстового рана. В конце — смещение записи во
+// входе, 10 байт по 7 бит со старшим битом: оно делает сортировку
+// устойчивой и по нему запись собирается при выводе.
+//
+// В памяти ключи лежат в StringArena и сортируются stringSort. Внешняя
+// сортировка пишет ключи во временный файл и сортирует его как строки;
+// при слиянии каждый ключ превращается обратно в строку входа.
+//
+// Ключи записей с равными колонками отличаются только смещением и идут
+// подряд, первой — раньше стоящая во входе; --unique оставляет её одну.
+
+struct KeyColumn {
+    size_t column = 0;      // с нуля
+    bool numeric = false;
+    bool reverse = false;
+};
+
+struct RecordKeySpec {
+    std::vector<KeyColumn> columns;
+    char separator = ',';
+};
+
+constexpr size_t RECORD_OFFSET_BYTES = 10;
+
+// "2n,1s,3nr" -> колонки; false — ошибка разбора
+inline bool parseKeySpec(const std::string& text, RecordKeySpec& spec) {
+    spec.columns.clear();
+    size_t i = 0;
+    while (i < text.size()) {
+        KeyColumn key;
+        size_t digits = 0, column = 0;
+        for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i, ++digits)
+            column = column * 10 + static_cast<size_t>(text[i] - '0');
+        if (digits == 0 || column == 0) return false;
+        key.column = column - 1;
+        for (; i < text.size() && text[i] != ','; ++i) {
+            if (text[i] == 'n') key.numeric = true;
+            else if (text[i] == 's') key.numeric = false;
+            else if (text[i] == 'r') key.reverse = true;
+            else return false;
+        }
+        spec.columns.push_back(key);
+        if (i < text.size()) ++i;   // ','
+    }
+    return !spec.columns.empty();
+}
+
+namespace record_sort_detail {
+
+// Колонка column строки line; нет такой — false
+inline bool field(std::string_view line, size_t column, char separator, std::string_view& value) {
+    size_t begin = 0;
+    for (size_t c = 0; c < column; ++c) {
+        const size_t sep = line.find(separator, begin);
+        if (sep == std::string_view::npos) return false;
+        begin = sep + 1;
+    }
+    size_t end = line.find(separator, begin);
+    if (end == std::string_view::npos) end = line.size();
+    if (end > begin && line[end - 1] == '\r') --end;   // CRLF в последней колонке
+    value = line.substr(begin, end - begin);
+    return true;
+}
+
+inline void encodeColumn(std::string_view line, const KeyColumn& key, char separator, std::string& raw) {
+    const size_t start = raw.size();
+    std::string_view value;
+    const bool present = field(line, key.column, separator, value);
+    if (key.numeric) {
+        double number = 0;
+        const char* p = value.data();
+        const bool parsed = present && mapped_input_detail::parseNumber(p, value.data() + value.size(), number);
+        raw.push_back(parsed ? '\x02' : '\x01');
+        const std::uint64_t bits = parsed ? toRadixKey(number, false) : 0;
+        for (int shift = 56; shift >= 0; shift -= 8) raw.push_back(static_cast<char>(bits >> shift));
+    } else {
+        for (char c : value) {
+            raw.push_back(c);
+            if (c == '\0') raw.push_back('\xFF');
+        }
+        raw.push_back('\0');
+        raw.push_back('\x01');
+    }
+    if (key.reverse)
+        for (size_t i = start; i < raw.size(); ++i) raw[i] = static_cast<char>(~raw[i]);
+}
+
+}  // namespace record_sort_detail
+
+// Ключ записи line со смещением offset во входе; raw — рабочий буфер.
+// descending обращает все колонки
+inline void encodeRecordKey(std::string_view line, std::uint64_t offset, const RecordKeySpec& spec,
+                            bool descending, std::string& raw, std::string& key) {
+    raw.clear();
+    for (KeyColumn column : spec.columns) {
+        column.reverse = column.reverse != descending;
+        record_sort_detail::encodeColumn(line, column, spec.separator, raw);
+    }
+    key.clear();
+    for (char c : raw) {
+        if (c == '\n' || c == '\x0B') {
+            key.push_back('\x0B');
+            key.push_back(c == '\n' ? '\x01' : '\x02');
+        } else {
+            key.push_back(c);
+        }
+    }
+    for (int shift = 7 * (RECORD_OFFSET_BYTES - 1); shift >= 0; shift -= 7)
+        key.push_back(static_cast<char>(0x80 | ((offset >> shift) & 0x7F)));
+}
+
+inline std::uint64_t recordOffsetOf(std::string_view key) {
+    std::uint64_t offset = 0;
+    for (size_t i = key.size() - RECORD_OFFSET_BYTES; i < key.size(); ++i)
+        offset = (offset << 7) | (static_cast<unsigned char>(key[i]) & 0x7F);
+    return offset;
+}
+
+// Ключи равны без учёта смещения: записи совпадают по всем колонкам ключа
+struct SameRecordKey {
+    bool operator()(std::string_view a, std::string_view b) const {
+        return a.substr(0, a.size() - RECORD_OFFSET_BYTES) == b.substr(0, b.size() - RECORD_OFFSET_BYTES);
+    }
+};
+
+// Строка входа, начинающаяся со смещения offset, без перевода строки
+inline std::string_view recordAt(std::string_view input, std::uint64_t offset) {
+    std::string_view rest = input.substr(static_cast<size_t>(offset));
+    return rest.substr(0, std::min(rest.find('\n'), rest.size()));
+}
+
+// Сборка записей при выводе внешней сортировки: ключ -> строка входа.
+// С unique запись с тем же ключом, что у предыдущей, пропускается
+struct GatherRecords {
+    explicit GatherRecords(std::string_view input, bool unique = false) : input(input), unique(unique) {}
+
+    std::string_view input;
+    bool unique;
+    mutable std::string last;
+
+    void operator()(OutputWriter& out, const std::string& key) const {
+        if (unique) {
+            if (!last.empty() && SameRecordKey()(last, key)) return;
+            last = key;
+        }
+        out.write(recordAt(input, recordOffsetOf(key)));
+    }
+};
+
+// Ключи всех непустых строк входа, по одному на строку файла keysFile
+inline bool writeRecordKeys(const MappedInput& input, const RecordKeySpec& spec, bool descending,
+                            const std::string& keysFile) {
+    OutputWriter out(keysFile);
+    InputCursor cursor(input);
+    const char* base = input.data().data();
+    std::string raw, key;
+    std::string_view line;
+    while (cursor.nextLine(line)) {
+        encodeRecordKey(line, static_cast<std::uint64_t>(line.data() - base), spec, descending, raw, key);
+        out.write(key);
+    }
+    return out.close();
+}
+
+// Сортировка в памяти: ключи в арене, записи собираются при выводе
+inline bool sortRecordsToFile(const MappedInput& input, const RecordKeySpec& spec, bool descending,
+                              bool unique, const std::string& outputFile, WorkStealingPool& pool,
+                              unsigned threads) {
+    const std::string_view data = input.data();
+    const auto lines = input.lines(threads);
+    StringArena keys;
+    keys.reserve(lines.size(), lines.size() * (RECORD_OFFSET_BYTES + 16 * spec.columns.size()));
+    std::string raw, key;
+    for (const auto& line : lines) {
+        encodeRecordKey(line, static_cast<std::uint64_t>(line.data() - data.data()), spec, descending, raw, key);
+        keys.add(key);
+    }
+    stringSort(keys, false, &pool);
+    if (unique) {
+        auto& records = keys.records;
+        records.erase(std::unique(records.begin(), records.end(),
+                                  [&keys](const StringRecord& a, const StringRecord& b) {
+                                      return SameRecordKey()(keys.view(a), keys.view(b));
+                                  }),
+                      records.end());
+    }
+
+    OutputWriter out(outputFile);
+    out.writeAll(keys.size(), [&](size_t i) {
+        return recordAt(data, recordOffsetOf(keys.view(keys.records[i])));
+    }, threads);
+    return out.close();
+}
+
+// Первые limit записей по ключу за один проход (--top): каждый поток держит
+// кандидатов-ключей своей части входа, записи собираются только для итоговых
+inline bool selectTopRecordsToFile(const MappedInput& input, const RecordKeySpec& spec, bool descending,
+                                   size_t limit, bool unique, const std::string& outputFile,
+                                   unsigned threads) {
+    using Candidates = TopCandidates<std::string, std::less<std::string>, SameRecordKey>;
+    const std::string_view data = input.data();
+    std::vector<Candidates> parts(threads, Candidates(limit, unique));
+    std::vector<std::string> raws(threads), keys(threads);
+    input.forEachLine(threads, [&](size_t part, std::string_view line) {
+        encodeRecordKey(line, static_cast<std::uint64_t>(line.data() - data.data()), spec, descending,
+                        raws[part], keys[part]);
+        parts[part].offer(keys[part]);
+    });
+
+    Candidates all(limit, unique);
+    for (auto& part : parts)
+        for (const auto& key : part.take()) all.offer(key);
+
+    OutputWriter out(outputFile);
+    for (const auto& key : all.take()) out.write(recordAt(data, recordOffsetOf(key)));
+    return out.close();
+}
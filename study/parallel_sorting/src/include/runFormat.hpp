@@ -0,0 +1,378 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "AsyncIO.hpp"
+#include "MappedInput.hpp"
+#include "OutputWriter.hpp"
+
+
+// ---------- Формат ранов ----------
+//
+// Ран (.partN) — отсортированная (или ещё нет) порция данных на диске.
+// Бинарный ран: заголовок RunHeader и count значений T в машинном
+// представлении. Текст разбирается один раз на входе и форматируется один раз
+// при записи итогового файла. Текстовый ран — старый формат "одно значение на
+// строку", оставлен для отладки (--text-runs) и для строк.
+
+enum class RunFormat : std::uint8_t { Binary, Text };
+
+enum class RunOrder : std::uint8_t { Unsorted = 0, Ascending = 1, Descending = 2 };
+
+template<typename Compare>
+struct run_order_of { static constexpr RunOrder value = RunOrder::Unsorted; };
+
+template<typename T>
+struct run_order_of<std::less<T>> { static constexpr RunOrder value = RunOrder::Ascending; };
+
+template<typename T>
+struct run_order_of<std::greater<T>> { static constexpr RunOrder value = RunOrder::Descending; };
+
+struct RunHeader {
+    char magic[4];          // "PSRT"
+    std::uint8_t version;
+    std::uint8_t kind;      // 'i' — знаковое целое, 'u' — беззнаковое, 'f' — плавающая точка
+    std::uint8_t width;     // sizeof(T)
+    std::uint8_t order;     // RunOrder
+    std::uint64_t count;    // количество значений после заголовка
+};
+static_assert(sizeof(RunHeader) == 16, "RunHeader должен занимать 16 байт");
+
+constexpr char RUN_MAGIC[4] = {'P', 'S', 'R', 'T'};
+constexpr std::uint8_t RUN_VERSION = 1;
+
+template<typename T>
+constexpr std::uint8_t runKindOf() {
+    if constexpr (std::is_floating_point_v<T>) return 'f';
+    else if constexpr (std::is_signed_v<T>) return 'i';
+    else return 'u';
+}
+
+// Бинарный формат есть только у числовых типов, строки всегда пишутся текстом
+template<typename T>
+constexpr RunFormat effectiveRunFormat(RunFormat requested) {
+    if constexpr (std::is_arithmetic_v<T>) return requested;
+    else return RunFormat::Text;
+}
+
+template<typename T>
+RunHeader makeRunHeader(RunOrder order, std::uint64_t count) {
+    RunHeader h{};
+    std::memcpy(h.magic, RUN_MAGIC, sizeof(h.magic));
+    h.version = RUN_VERSION;
+    h.kind = runKindOf<T>();
+    h.width = static_cast<std::uint8_t>(sizeof(T));
+    h.order = static_cast<std::uint8_t>(order);
+    h.count = count;
+    return h;
+}
+
+// ---------- Потоковая запись рана ----------
+//
+// Запись идёт через OutputWriter: бинарные значения копируются в его буфер,
+// текстовые форматируются to_chars. Заголовок бинарного рана дописывается
+// в начало файла при close(), когда известно количество. Если запись не
+// удалась, close() удаляет файл: с заголовком-заглушкой (count = 0) он
+// читался бы как корректный пустой ран.
+
+constexpr std::size_t RUN_WRITE_BUFFER = 1 << 20;
+
+template<typename T>
+class RunWriter {
+public:
+    // io — запись в фоне из двух буферов; должен пережить писатель
+    RunWriter(const std::string& filename, RunFormat format, RunOrder order = RunOrder::Unsorted,
+              std::size_t bufferBytes = 0, AsyncIO* io = nullptr)
+        : format_(effectiveRunFormat<T>(format)), order_(order) {
+        if (!out_.open(filename, bufferBytes ? bufferBytes : RUN_WRITE_BUFFER, io)) return;
+        path_ = filename;
+        if (format_ == RunFormat::Binary) {
+            RunHeader h = makeRunHeader<T>(order_, 0);
+            out_.writeBytes(&h, sizeof(h));
+        }
+    }
+
+    ~RunWriter() { close(); }
+
+    bool ok() const { return out_.ok(); }
+
+    void write(const T& value) {
+        if constexpr (std::is_arithmetic_v<T>) {
+            if (format_ == RunFormat::Binary) {
+                out_.writeBytes(&value, sizeof(T));
+                ++count_;
+                return;
+            }
+        }
+        out_.write(value);
+        ++count_;
+    }
+
+    void write(const std::vector<T>& data) {
+        if constexpr (std::is_arithmetic_v<T>) {
+            if (format_ == RunFormat::Binary) {
+                out_.writeBytes(data.data(), data.size() * sizeof(T));
+                count_ += data.size();
+                return;
+            }
+        }
+        // Ран пишется из потока сортировки — форматируем в нём же
+        out_.writeAll(data, 1);
+        count_ += data.size();
+    }
+
+    bool close() {
+        if (closed_) return ok();
+        closed_ = true;
+        if (format_ == RunFormat::Binary && out_.ok()) {
+            RunHeader h = makeRunHeader<T>(order_, count_);
+            out_.writeAt(0, &h, sizeof(h));
+        }
+        if (out_.close()) return true;
+        if (!path_.empty()) ::unlink(path_.c_str());
+        return false;
+    }
+
+    std::uint64_t count() const { return count_; }
+
+private:
+    OutputWriter out_;
+    std::string path_;      // пусто, если файл не создан
+    RunFormat format_;
+    RunOrder order_;
+    std::uint64_t count_ = 0;
+    bool closed_ = false;
+};
+
+
+// ---------- Потоковое чтение рана ----------
+//
+// Бинарный ран читается в собственный блок по blockBytes одним pread на
+// блок, так что при слиянии сотен ранов каждое обращение к диску остаётся
+// крупным. С AsyncIO блоков два: пока слияние разбирает один, следующий уже
+// читается (prefetch). Если все места AsyncIO заняты, блок дочитывается
+// синхронно, когда до него дойдёт очередь. Текстовый ран отображается в
+// память и разбирается курсором InputCursor; пройденные страницы отдаются
+// ядру, упреждающее чтение делает само ядро (MADV_SEQUENTIAL).
+//
+// Бинарный ран, кончившийся раньше count значений из заголовка, — такая же
+// ошибка, как неудачный pread: next() возвращает false, а ok() — false.
+// Слияние проверяет ok() всех ранов после того, как они иссякли.
+
+constexpr std::size_t DEFAULT_READ_BLOCK = 1 << 20;
+
+template<typename T>
+class RunReader {
+public:
+    RunReader() = default;
+
+    RunReader(const std::string& filename, RunFormat format, std::size_t blockBytes = DEFAULT_READ_BLOCK,
+              AsyncIO* io = nullptr) {
+        open(filename, format, blockBytes, io);
+    }
+
+    ~RunReader() { close(); }
+
+    // Блок в полёте пишет в буфер читателя — ни копировать, ни перемещать нельзя
+    RunReader(const RunReader&) = delete;
+    RunReader& operator=(const RunReader&) = delete;
+
+    // io должен пережить читатель
+    bool open(const std::string& filename, RunFormat format, std::size_t blockBytes = DEFAULT_READ_BLOCK,
+              AsyncIO* io = nullptr) {
+        close();
+        format_ = effectiveRunFormat<T>(format);
+        failed_ = true;
+        if (format_ == RunFormat::Text) {
+            if (!mapped_.open(filename)) return false;
+            cursor_ = InputCursor(mapped_);
+            failed_ = false;
+            return true;
+        }
+        blockBytes = std::max<std::size_t>(blockBytes, 4096);
+        blockCapacity_ = std::max<std::size_t>(blockBytes / sizeof(T), 1);
+        io_ = io && io->enabled() ? io : nullptr;
+        fd_ = ::open(filename.c_str(), O_RDONLY);
+        if (fd_ < 0) return false;
+        RunHeader h{};
+        if (!readExact(&h, sizeof(h), 0) || std::memcmp(h.magic, RUN_MAGIC, sizeof(h.magic)) != 0 ||
+            h.version != RUN_VERSION || h.kind != runKindOf<T>() || h.width != sizeof(T)) {
+            std::cerr << "Ошибка: \"" << filename << "\" не является бинарным раном этого типа\n";
+            return false;
+        }
+        failed_ = false;
+        order_ = static_cast<RunOrder>(h.order);
+        remaining_ = total_ = h.count;
+        offset_ = sizeof(RunHeader);
+        return true;
+    }
+
+    bool ok() const { return !failed_; }
+
+    bool next(T& value) {
+        if constexpr (std::is_arithmetic_v<T>) {
+            if (format_ == RunFormat::Binary) {
+                if (pos_ == block_.size() && !refill()) return false;
+                value = block_[pos_++];
+                return true;
+            }
+        }
+        return cursor_.next(value);
+    }
+
+    // Бинарный ран: начать чтение следующего блока в фоне, если есть AsyncIO
+    // и блок ещё не запрошен. Слияние вызывает это для всех ранов сразу,
+    // чтобы первые блоки читались одновременно
+    void prefetch() {
+        if (!io_ || ahead_ != AsyncIO::NO_TICKET || remaining_ == 0 || failed_) return;
+        const std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(remaining_, blockCapacity_));
+        aheadBlock_.resize(n);
+        const AsyncIO::Ticket ticket = io_->read(fd_, aheadBlock_.data(), n * sizeof(T), offset_);
+        if (ticket == AsyncIO::NO_TICKET) return;
+        ahead_ = ticket;
+        offset_ += n * sizeof(T);
+        remaining_ -= n;
+    }
+
+    // Дочитывает ран целиком; бинарный — одним pread
+    void readAll(std::vector<T>& data) {
+        if constexpr (std::is_arithmetic_v<T>) {
+            if (format_ == RunFormat::Binary) {
+                data.insert(data.end(), block_.begin() + pos_, block_.end());
+                pos_ = block_.size();
+                if (ahead_ != AsyncIO::NO_TICKET) {
+                    const std::size_t got = takeAhead();
+                    data.insert(data.end(), aheadBlock_.begin(), aheadBlock_.begin() + got);
+                }
+                const std::size_t start = data.size();
+                data.resize(start + remaining_);
+                const long got = readSome(data.data() + start, remaining_ * sizeof(T), offset_);
+                data.resize(start + static_cast<std::size_t>(std::max(got, 0L)) / sizeof(T));
+                if (got != static_cast<long>(remaining_ * sizeof(T))) failed_ = true;
+                remaining_ = 0;
+                return;
+            }
+        }
+        T value;
+        while (next(value)) data.push_back(std::move(value));
+    }
+
+    // Для бинарного рана — сколько значений ещё не прочитано
+    std::uint64_t remaining() const {
+        return remaining_ + (ahead_ != AsyncIO::NO_TICKET ? aheadBlock_.size() : 0) + (block_.size() - pos_);
+    }
+
+    // Для бинарного рана — сколько значений в файле всего
+    std::uint64_t size() const { return total_; }
+
+    // Бинарный ран: произвольный доступ по номеру значения (для поиска
+    // границ диапазона). Позиция чтения не меняется.
+    bool readAt(std::uint64_t index, T& value) {
+        if (format_ != RunFormat::Binary || index >= total_ || fd_ < 0) return false;
+        if (readExact(&value, sizeof(T), sizeof(RunHeader) + index * sizeof(T))) return true;
+        failed_ = true;
+        return false;
+    }
+
+    // Бинарный ран: дальше читать только значения [first, first + count)
+    bool seekRange(std::uint64_t first, std::uint64_t count) {
+        if (format_ != RunFormat::Binary || first + count > total_ || fd_ < 0) return false;
+        if (ahead_ != AsyncIO::NO_TICKET) takeAhead();
+        offset_ = sizeof(RunHeader) + first * sizeof(T);
+        block_.clear();
+        pos_ = 0;
+        remaining_ = count;
+        return true;
+    }
+    RunOrder order() const { return order_; }
+
+    void close() {
+        if (ahead_ != AsyncIO::NO_TICKET) takeAhead();
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+        io_ = nullptr;
+        cursor_ = InputCursor();
+        mapped_.close();
+        std::vector<T>().swap(block_);
+        std::vector<T>().swap(aheadBlock_);
+        pos_ = 0;
+        remaining_ = 0;
+    }
+
+private:
+    bool refill() {
+        if (ahead_ != AsyncIO::NO_TICKET) {
+            const std::size_t got = takeAhead();
+            std::swap(block_, aheadBlock_);
+            block_.resize(got);
+        } else {
+            if (remaining_ == 0 || failed_) return false;
+            const std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(remaining_, blockCapacity_));
+            block_.resize(n);
+            const long got = readSome(block_.data(), n * sizeof(T), offset_);
+            block_.resize(static_cast<std::size_t>(std::max(got, 0L)) / sizeof(T));
+            if (block_.size() < n) {
+                failed_ = true;
+                remaining_ = 0;
+            } else {
+                remaining_ -= n;
+            }
+            offset_ += n * sizeof(T);
+        }
+        pos_ = 0;
+        prefetch();
+        return !block_.empty();
+    }
+
+    // Дожидается блока в полёте; сколько значений в нём пришло. Короткий
+    // блок — ошибка чтения или файл короче заголовка, дальше не читаем
+    std::size_t takeAhead() {
+        const long got = io_->wait(ahead_);
+        ahead_ = AsyncIO::NO_TICKET;
+        const std::size_t values = static_cast<std::size_t>(std::max(got, 0L)) / sizeof(T);
+        if (values < aheadBlock_.size()) {
+            failed_ = true;
+            remaining_ = 0;
+        }
+        return values;
+    }
+
+    long readSome(void* buf, std::size_t bytes, std::uint64_t offset) {
+        IOWaitTimer timer;
+        const long got = async_io_detail::transfer(false, fd_, static_cast<char*>(buf), bytes, offset);
+        async_io_detail::countBytes(false, got);
+        return got;
+    }
+
+    bool readExact(void* buf, std::size_t bytes, std::uint64_t offset) {
+        return readSome(buf, bytes, offset) == static_cast<long>(bytes);
+    }
+
+    int fd_ = -1;           // бинарный ран
+    MappedInput mapped_;    // текстовый ран
+    InputCursor cursor_;
+    RunFormat format_ = RunFormat::Binary;
+    RunOrder order_ = RunOrder::Unsorted;
+    bool failed_ = false;
+    std::uint64_t remaining_ = 0;   // значений, ещё не запрошенных с диска
+    std::uint64_t total_ = 0;
+    std::uint64_t offset_ = 0;      // смещение первого незапрошенного значения
+
+    std::vector<T> block_;
+    std::size_t pos_ = 0;
+    std::size_t blockCapacity_ = 1;
+
+    AsyncIO* io_ = nullptr;
+    std::vector<T> aheadBlock_;     // следующий блок, читается в фоне
+    AsyncIO::Ticket ahead_ = AsyncIO::NO_TICKET;
+};
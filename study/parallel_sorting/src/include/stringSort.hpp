@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "WorkStealingPool.hpp"
+
+
+// ---------- Сортировка строк (MSD radix с кэшированным префиксом) ----------
+//
+// Строки лежат подряд в одной арене, сортируется массив записей
+// (префикс, смещение, длина). Префикс — 8 байт строки начиная с текущего
+// окна, упакованные big-endian в uint64, так что порядок чисел совпадает с
+// лексикографическим. Раскладка по очередному байту берёт его из префикса,
+// не трогая арену; в арену сортировка ходит только раз на 8 уровней, чтобы
+// перезагрузить префиксы, и на коротких диапазонах при сравнении хвостов.
+//
+// На каждом уровне 257 корзин: 0 — строка кончилась, 1 + байт — иначе.
+// Строки в корзине 0 совпадают целиком и дальше не сортируются. Корзина,
+// в которую попал весь диапазон, не порождает рекурсию — уровень просто
+// сдвигается. Диапазоны короче STRING_INSERTION_THRESHOLD досортировываются
+// вставками. С пулом крупные корзины сортируются параллельными задачами.
+// Убывание — обращённый результат: равные строки побайтно одинаковы.
+
+struct StringRecord {
+    std::uint64_t prefix;
+    std::uint64_t offset;
+    std::uint32_t length;
+};
+
+// Арена либо владеет байтами (add копирует строку в data), либо ссылается
+// на внешний буфер — например, на отображённый файл: тогда add принимает
+// только string_view внутрь этого буфера и ничего не копирует
+class StringArena {
+public:
+    StringArena() = default;
+    explicit StringArena(std::string_view external) : external_(external) {}
+
+    void reserve(size_t strings, size_t bytes) {
+        records.reserve(strings);
+        if (!external_.data()) data.reserve(bytes);
+    }
+
+    void add(std::string_view s) {
+        const auto length = static_cast<std::uint32_t>(s.size());
+        if (external_.data()) {
+            records.push_back({0, static_cast<std::uint64_t>(s.data() - external_.data()), length});
+            return;
+        }
+        records.push_back({0, data.size(), length});
+        data.insert(data.end(), s.begin(), s.end());
+    }
+
+    size_t size() const { return records.size(); }
+
+    // Опустошает арену, сохраняя ёмкость: её можно заполнять заново без выделений
+    void clear() {
+        records.clear();
+        data.clear();
+    }
+
+    const char* bytes() const { return external_.data() ? external_.data() : data.data(); }
+
+    std::string_view view(const StringRecord& r) const { return {bytes() + r.offset, r.length}; }
+
+    std::vector<char> data;
+    std::vector<StringRecord> records;
+
+private:
+    std::string_view external_;
+};
+
+constexpr size_t STRING_INSERTION_THRESHOLD = 32;
+constexpr size_t STRING_SORT_GRAIN = 1 << 13;
+
+namespace string_sort_detail {
+
+constexpr size_t BUCKETS = 257;
+
+// 8 байт строки начиная с window, big-endian, недостающие — нули
+inline std::uint64_t loadPrefix(const char* bytes, const StringRecord& r, size_t window) {
+    std::uint64_t prefix = 0;
+    const size_t available = r.length > window ? std::min<size_t>(r.length - window, 8) : 0;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(bytes + r.offset + window);
+    for (size_t i = 0; i < available; ++i)
+        prefix |= std::uint64_t(p[i]) << (56 - 8 * i);
+    return prefix;
+}
+
+inline size_t bucketOf(const StringRecord& r, size_t depth) {
+    if (depth >= r.length) return 0;
+    return 1 + static_cast<size_t>((r.prefix >> (56 - 8 * (depth % 8))) & 0xFF);
+}
+
+// Все записи диапазона совпадают на первых depth байтах, префиксы загружены
+// с окна depth - depth % 8
+inline bool less(const char* bytes, const StringRecord& a, const StringRecord& b, size_t depth) {
+    if (a.prefix != b.prefix) return a.prefix < b.prefix;
+    const size_t window = depth - depth % 8 + 8;
+    const std::string_view ta = a.length > window ? std::string_view(bytes + a.offset + window, a.length - window)
+                                                  : std::string_view();
+    const std::string_view tb = b.length > window ? std::string_view(bytes + b.offset + window, b.length - window)
+                                                  : std::string_view();
+    return ta < tb || (ta == tb && a.length < b.length);
+}
+
+inline void insertionSort(const char* bytes, StringRecord* r, size_t n, size_t depth) {
+    for (size_t i = 1; i < n; ++i) {
+        if (!less(bytes, r[i], r[i - 1], depth)) continue;
+        StringRecord value = r[i];
+        size_t j = i;
+        do {
+            r[j] = r[j - 1];
+            --j;
+        } while (j > 0 && less(bytes, value, r[j - 1], depth));
+        r[j] = value;
+    }
+}
+
+// Сортирует r[lo, hi); tmp — буфер того же размера, что и весь массив
+inline void sortRange(const char* bytes, StringRecord* r, StringRecord* tmp, size_t lo, size_t hi,
+                      size_t depth, WorkStealingPool* pool, WorkStealingPool::Group* group) {
+    while (hi - lo > 1) {
+        if (depth % 8 == 0 && depth > 0) {
+            for (size_t i = lo; i < hi; ++i) r[i].prefix = loadPrefix(bytes, r[i], depth);
+        }
+        if (hi - lo <= STRING_INSERTION_THRESHOLD) {
+            insertionSort(bytes, r + lo, hi - lo, depth);
+            return;
+        }
+
+        std::array<size_t, BUCKETS> count{};
+        for (size_t i = lo; i < hi; ++i) ++count[bucketOf(r[i], depth)];
+        if (count[0] == hi - lo) return;   // все строки кончились — они равны
+
+        // Весь диапазон в одной корзине — переходим к следующему байту
+        const auto full = std::find(count.begin() + 1, count.end(), hi - lo);
+        if (full != count.end()) {
+            ++depth;
+            continue;
+        }
+
+        std::array<size_t, BUCKETS> start;
+        size_t position = lo;
+        for (size_t b = 0; b < BUCKETS; ++b) {
+            start[b] = position;
+            position += count[b];
+        }
+        std::array<size_t, BUCKETS> next = start;
+        for (size_t i = lo; i < hi; ++i) tmp[next[bucketOf(r[i], depth)]++] = r[i];
+        std::copy(tmp + lo, tmp + hi, r + lo);
+
+        for (size_t b = 1; b < BUCKETS; ++b) {
+            const size_t first = start[b], last = first + count[b];
+            if (last - first < 2) continue;
+            if (pool && last - first >= STRING_SORT_GRAIN) {
+                pool->spawn(*group, [bytes, r, tmp, first, last, depth, pool, group]() {
+                    sortRange(bytes, r, tmp, first, last, depth + 1, pool, group);
+                });
+            } else {
+                sortRange(bytes, r, tmp, first, last, depth + 1, nullptr, nullptr);
+            }
+        }
+        return;
+    }
+}
+
+}  // namespace string_sort_detail
+
+// pool == nullptr — в вызывающем потоке. scratch — буфер раскладки
+// вызывающего; без него выделяется на время вызова
+inline void stringSort(StringArena& arena, bool descending = false, WorkStealingPool* pool = nullptr,
+                       std::vector<StringRecord>* scratch = nullptr) {
+    using namespace string_sort_detail;
+    auto& records = arena.records;
+    const size_t n = records.size();
+    if (n < 2) return;
+
+    const char* bytes = arena.bytes();
+    for (auto& r : records) r.prefix = loadPrefix(bytes, r, 0);
+
+    std::vector<StringRecord> own;
+    std::vector<StringRecord>& tmp = scratch ? *scratch : own;
+    tmp.resize(n);
+    if (pool && pool->size() > 1 && n >= 2 * STRING_SORT_GRAIN) {
+        WorkStealingPool::Group group;
+        pool->spawn(group, [&]() { sortRange(bytes, records.data(), tmp.data(), 0, n, 0, pool, &group); });
+        pool->wait(group);
+    } else {
+        sortRange(bytes, records.data(), tmp.data(), 0, n, 0, nullptr, nullptr);
+    }
+
+    if (descending) std::reverse(records.begin(), records.end());
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "MappedInput.hpp"
+
+
+// ---------- Первые N значений без полной сортировки (--top) ----------
+//
+// Вход проходится один раз в нескольких потоках, каждый поток держит только
+// кандидатов своей части файла. Кандидаты копятся в буфере до 2N; заполненный
+// буфер ужимается до N лучших (nth_element, с --unique — сортировка и
+// удаление повторов), и N-й из них становится порогом: значение не лучше
+// порога отбрасывается одним сравнением, не попадая в буфер. На больших
+// входах почти всё отсекается порогом, так что проход упирается в разбор
+// входа, а памяти нужно O(N) на поток.
+//
+// В конце кандидаты частей сливаются в том же порядке частей и ужимаются
+// ещё раз — сортируется не больше 2N значений на часть.
+//
+// Равенство для --unique задаёт same: по умолчанию ==, для записей —
+// равенство ключа без смещения. При равных ключах остаётся значение,
+// раньше идущее по comp.
+
+template<typename V, typename Compare = std::less<V>, typename Same = std::equal_to<>>
+class TopCandidates {
+public:
+    TopCandidates(size_t limit, bool unique, Compare comp = Compare(), Same same = Same())
+        : limit_(limit), unique_(unique), comp_(comp), same_(same) {}
+
+    void offer(const V& value) {
+        if (limit_ == 0 || (bounded_ && !comp_(value, bound_))) return;
+        items_.push_back(value);
+        if (items_.size() >= 2 * limit_) compact();
+    }
+
+    // Не больше limit лучших кандидатов по порядку comp
+    std::vector<V> take() {
+        std::sort(items_.begin(), items_.end(), comp_);
+        if (unique_) dedup();
+        if (items_.size() > limit_) items_.resize(limit_);
+        bounded_ = false;
+        return std::move(items_);
+    }
+
+private:
+    void compact() {
+        if (unique_) {
+            std::sort(items_.begin(), items_.end(), comp_);
+            dedup();
+            if (items_.size() < limit_) return;   // повторы съели буфер — порога пока нет
+        } else {
+            std::nth_element(items_.begin(), items_.begin() + (limit_ - 1), items_.end(), comp_);
+        }
+        items_.resize(limit_);
+        bound_ = items_[limit_ - 1];   // nth_element: всё левее не хуже
+        bounded_ = true;
+    }
+
+    void dedup() {
+        items_.erase(std::unique(items_.begin(), items_.end(), same_), items_.end());
+    }
+
+    size_t limit_;
+    bool unique_;
+    Compare comp_;
+    Same same_;
+    std::vector<V> items_;
+    V bound_{};
+    bool bounded_ = false;
+};
+
+// Первые limit значений входа по порядку comp. T — число или
+// std::string_view (непустые строки, ссылки в отображение input).
+// threads == 0 — по числу ядер
+template<typename T, typename Compare = std::less<T>>
+std::vector<T> selectTop(const MappedInput& input, size_t limit, bool unique, size_t threads,
+                         Compare comp = Compare()) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<TopCandidates<T, Compare>> parts(threads, TopCandidates<T, Compare>(limit, unique, comp));
+    size_t used = threads;
+    if constexpr (std::is_arithmetic_v<T>) {
+        used = input.forEachValue<T>(threads, [&parts](size_t part, T value) { parts[part].offer(value); });
+    } else {
+        static_assert(std::is_same_v<T, std::string_view>, "selectTop<T>: число или std::string_view");
+        input.forEachLine(threads, [&parts](size_t part, std::string_view line) { parts[part].offer(line); });
+    }
+
+    TopCandidates<T, Compare> all(limit, unique, comp);
+    for (size_t i = 0; i < used; ++i)
+        for (const T& value : parts[i].take()) all.offer(value);
+    return all.take();
+}
@@ -4,10 +4,18 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <chrono>
 #include <type_traits>
 
 #include "include/mergeSorting.hpp"
 #include "include/quickSort.hpp"
+#include "include/radixSort.hpp"
+#include "include/stringSort.hpp"
+#include "include/MappedInput.hpp"
+#include "include/OutputWriter.hpp"
+#include "include/recordSort.hpp"
+#include "include/topSelect.hpp"
+#include "include/Profiler.hpp"
 
 
 
@@ -17,12 +25,82 @@ const unsigned max_threads = 11;
 
 void printUsage(const char* progName) {
     cerr << "Usage: " << progName
-         << " [ -q | --quick | -m | --merge ]"
+         << " [ -q | --quick | -m | --merge | -r | --radix ]"
          << " [ -a | --ascending | -d | --descending ]"
-         << " [ -i | --int | -f | --float | -s | --string ]"
+         << " [ -i | --int | -f | --float | -s | --string | -k <keys> [ -t <sep> ] ]"
+         << " [ --text-runs ] [ --memory <size>[K|M|G] ] [ --pipeline ]"
+         << " [ --runs fixed|replacement ]"
+         << " [ --read-block <size> ] [ --write-buffer <size> ]"
+         << " [ --parallel-merge | --merge-threads <n> ] [ --max-fan-in <n> ] [ --io-depth <n> ]"
+         << " [ -u | --unique ] [ --top <n> ] [ --report <file.json> ] [ --trace <file.json> ]"
          << " <input_file> <output_file>" << endl;
 }
 
+// Результат сортировки в памяти: count значений valueAt(i), блоки
+// форматируются в threads потоках
+template<typename ValueAt>
+bool writeOutput(const string& outputFile, size_t count, ValueAt valueAt, unsigned threads) {
+    profiler::ScopedTimer timer("output.write", count);
+    OutputWriter out(outputFile);
+    out.writeAll(count, valueAt, threads);
+    if (out.close()) return true;
+    cerr << "Error: Cannot write output file: " << outputFile << endl;
+    return false;
+}
+
+// Шаг сортировки в памяти как интервал профилировщика
+template<typename Fn>
+auto timed(const char* name, Fn&& fn) {
+    profiler::ScopedTimer timer(name);
+    return fn();
+}
+
+// Сводка (--report) и трасса (--trace) пишутся при выходе из main, после
+// того как все пулы потоков уже остановлены
+struct ProfileOutput {
+    string reportFile, traceFile;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    ~ProfileOutput() {
+        const double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (!reportFile.empty() && !profiler::writeSummary(reportFile, wall))
+            cerr << "Error: Cannot write report file: " << reportFile << endl;
+        if (!traceFile.empty() && !profiler::writeTrace(traceFile))
+            cerr << "Error: Cannot write trace file: " << traceFile << endl;
+    }
+};
+
+// Убирает повторы из отсортированного массива
+template<typename T>
+void dropRepeats(vector<T>& data) {
+    data.erase(unique(data.begin(), data.end()), data.end());
+}
+
+// Первые top значений входа за один проход, без сортировки всего файла
+template<typename T, typename Compare = less<T>>
+bool writeTop(const MappedInput& input, const string& outputFile, size_t top, bool uniqueOnly,
+              unsigned threads, Compare comp = Compare()) {
+    const vector<T> best = timed("select.top", [&] { return selectTop<T>(input, top, uniqueOnly, threads, comp); });
+    return writeOutput(outputFile, best.size(), [&](size_t i) { return best[i]; }, threads);
+}
+
+// Размер в байтах с необязательным суффиксом K/M/G, 0 — ошибка разбора
+uint64_t parseSize(const string& text) {
+    size_t pos = 0;
+    uint64_t value = 0;
+    try {
+        value = stoull(text, &pos);
+    } catch (...) {
+        return 0;
+    }
+    string suffix = text.substr(pos);
+    if (suffix.empty() || suffix == "B") return value;
+    if (suffix == "K" || suffix == "k") return value << 10;
+    if (suffix == "M" || suffix == "m") return value << 20;
+    if (suffix == "G" || suffix == "g") return value << 30;
+    return 0;
+}
+
 int main(int argc, char** argv) {
     if (argc < 4) {
         printUsage(argv[0]);
@@ -32,18 +110,98 @@ int main(int argc, char** argv) {
     string mode = argv[1];
     string order = "ascending";
     string type = "string";
+    ExternalSortConfig config;
+    RecordKeySpec keySpec;
+    uint64_t top = 0;
+    ProfileOutput profile;
     vector<string> flags;
     for (int i = 2; i < argc - 2; ++i) flags.push_back(argv[i]);
     string inputFile = argv[argc - 2];
     string outputFile = argv[argc - 1];
 
     // Обработка флагов
-    for (auto& flag : flags) {
+    for (size_t i = 0; i < flags.size(); ++i) {
+        const string& flag = flags[i];
         if (flag == "-a" || flag == "--ascending") order = "ascending";
         else if (flag == "-d" || flag == "--descending") order = "descending";
         else if (flag == "-i" || flag == "--int") type = "int";
         else if (flag == "-f" || flag == "--float") type = "float";
         else if (flag == "-s" || flag == "--string") type = "string";
+        else if (flag == "-k" || flag == "--key") {
+            if (i + 1 >= flags.size() || !parseKeySpec(flags[++i], keySpec)) {
+                cerr << "Error: " << flag << " expects columns such as 2n,1s" << endl;
+                return 1;
+            }
+            type = "record";
+        }
+        else if (flag == "-t" || flag == "--field-separator") {
+            const string sep = i + 1 < flags.size() ? flags[++i] : "";
+            if (sep == "\\t" || sep == "tab") keySpec.separator = '\t';
+            else if (sep.size() == 1) keySpec.separator = sep[0];
+            else {
+                cerr << "Error: " << flag << " expects a single character" << endl;
+                return 1;
+            }
+        }
+        else if (flag == "-u" || flag == "--unique") config.unique = true;
+        else if (flag == "--top") {
+            top = i + 1 < flags.size() ? strtoull(flags[++i].c_str(), nullptr, 10) : 0;
+            if (top == 0) {
+                cerr << "Error: --top expects a positive number" << endl;
+                return 1;
+            }
+        }
+        else if (flag == "--report" || flag == "--trace") {
+            if (i + 1 >= flags.size()) {
+                cerr << "Error: " << flag << " expects a file name" << endl;
+                return 1;
+            }
+            (flag == "--report" ? profile.reportFile : profile.traceFile) = flags[++i];
+            profiler::enable();
+        }
+        else if (flag == "--text-runs") config.runFormat = RunFormat::Text;
+        else if (flag == "--pipeline") config.pipeline = true;
+        else if (flag == "--read-block" || flag == "--write-buffer") {
+            uint64_t size = i + 1 < flags.size() ? parseSize(flags[++i]) : 0;
+            if (size == 0) {
+                cerr << "Error: " << flag << " expects a size such as 1M" << endl;
+                return 1;
+            }
+            (flag == "--read-block" ? config.readBlockBytes : config.writeBufferBytes) = size;
+        }
+        else if (flag == "--io-depth") {
+            int n = i + 1 < flags.size() ? atoi(flags[++i].c_str()) : -1;
+            if (n < 0 || n > 4096) {
+                cerr << "Error: --io-depth expects a number from 0 to 4096" << endl;
+                return 1;
+            }
+            config.ioDepth = static_cast<unsigned>(n);
+        }
+        else if (flag == "--parallel-merge") config.mergeThreads = 0;
+        else if (flag == "--merge-threads" || flag == "--max-fan-in") {
+            int n = i + 1 < flags.size() ? atoi(flags[++i].c_str()) : 0;
+            if (n <= 0 || (flag == "--max-fan-in" && n < 2)) {
+                cerr << "Error: " << flag << " expects a positive number" << endl;
+                return 1;
+            }
+            if (flag == "--merge-threads") config.mergeThreads = static_cast<unsigned>(n);
+            else config.maxFanIn = static_cast<uint64_t>(n);
+        }
+        else if (flag == "--runs") {
+            string strategy = i + 1 < flags.size() ? flags[++i] : "";
+            if (strategy == "fixed") config.runStrategy = RunStrategy::Fixed;
+            else if (strategy == "replacement") config.runStrategy = RunStrategy::Replacement;
+            else {
+                cerr << "Error: --runs expects 'fixed' or 'replacement'" << endl;
+                return 1;
+            }
+        }
+        else if (flag == "--memory") {
+            if (i + 1 >= flags.size() || (config.memoryBudget = parseSize(flags[++i])) == 0) {
+                cerr << "Error: --memory expects a size such as 512M" << endl;
+                return 1;
+            }
+        }
         else {
             cerr << "Error: Unknown flag '" << flag << "'" << endl;
             printUsage(argv[0]);
@@ -56,42 +214,109 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    // Первые N значений: один проход по входу в любом режиме, полный
+    // отсортированный результат не строится
+    const bool knownMode = mode == "-q" || mode == "--quick" || mode == "-m" || mode == "--merge" ||
+                           mode == "-r" || mode == "--radix";
+    if (top > 0 && knownMode) {
+        const unsigned threads = std::max(1u, std::min(std::thread::hardware_concurrency(), max_threads));
+        const bool descending = order == "descending";
+        MappedInput input(inputFile);
+        bool ok;
+        if (type == "record") {
+            ok = selectTopRecordsToFile(input, keySpec, descending, top, config.unique, outputFile, threads);
+            if (!ok) cerr << "Error: Cannot write output file: " << outputFile << endl;
+        } else if (type == "int") {
+            ok = descending ? writeTop<int>(input, outputFile, top, config.unique, threads, greater<int>())
+                            : writeTop<int>(input, outputFile, top, config.unique, threads);
+        } else if (type == "float") {
+            ok = descending ? writeTop<float>(input, outputFile, top, config.unique, threads, greater<float>())
+                            : writeTop<float>(input, outputFile, top, config.unique, threads);
+        } else {
+            ok = descending ? writeTop<string_view>(input, outputFile, top, config.unique, threads,
+                                                    greater<string_view>())
+                            : writeTop<string_view>(input, outputFile, top, config.unique, threads);
+        }
+        if (!ok) return 1;
+        cout << "Top-" << top << " selection completed." << endl;
+        return 0;
+    }
+
+    // Поразрядная сортировка в памяти, только для чисел
+    if (mode == "-r" || mode == "--radix") {
+        if (type == "string" || type == "record") {
+            cerr << "Error: radix sort supports only --int and --float" << endl;
+            return 1;
+        }
+        const unsigned threads = std::max(1u, std::min(std::thread::hardware_concurrency(), max_threads));
+        ThreadPool pool(threads);
+        MappedInput input(inputFile);
+        if (type == "int") {
+            vector<int> data = timed("input.parse", [&] { return input.values<int>(threads); });
+            timed("sort.radix", [&] { radixSort(data, order == "descending", &pool); });
+            if (config.unique) dropRepeats(data);
+            if (!writeOutput(outputFile, data.size(), [&](size_t i) { return data[i]; }, threads)) return 1;
+        } else {
+            vector<float> data = timed("input.parse", [&] { return input.values<float>(threads); });
+            timed("sort.radix", [&] { radixSort(data, order == "descending", &pool); });
+            if (config.unique) dropRepeats(data);
+            if (!writeOutput(outputFile, data.size(), [&](size_t i) { return data[i]; }, threads)) return 1;
+        }
+        cout << "Radix sort completed." << endl;
+        return 0;
+    }
+
     // Быстрая сортировка
     if (mode == "-q" || mode == "--quick") {
+        const unsigned threads = std::max(1u, std::min(std::thread::hardware_concurrency(), max_threads));
+        WorkStealingPool pool(threads);
+        MappedInput input(inputFile);
         if (type == "int") {
-            vector<int> data;
-            ifstream in(inputFile);
-            int v;
-            while (in >> v) data.push_back(v);
-            if (order == "ascending") quickSort<int>(data, 0, data.size() - 1);
-            else quickSort<int>(data, 0, data.size() - 1, greater<int>());
-            ofstream out(outputFile);
-            for (auto x : data) out << x << '\n';
+            vector<int> data = timed("input.parse", [&] { return input.values<int>(threads); });
+            timed("sort.quick", [&] {
+                if (order == "ascending") parallelQuickSort<int>(data, pool);
+                else parallelQuickSort<int>(data, pool, greater<int>());
+            });
+            if (config.unique) dropRepeats(data);
+            if (!writeOutput(outputFile, data.size(), [&](size_t i) { return data[i]; }, threads)) return 1;
         } else if (type == "float") {
-            std::vector<float> data;
-            std::ifstream in(inputFile);
-            float v;
-            while (in >> v) data.push_back(v);
-            if (order == "ascending")
-                quickSort<float>(data, 0, data.size() - 1);
-            else
-                quickSort<float>(data, 0, data.size() - 1, std::greater<float>());
-            
-            std::ofstream out(outputFile);
-            // Включаем фиксированный формат и максимальную точность для float
-            out << std::fixed
-                << std::setprecision(std::numeric_limits<float>::max_digits10);
-            for (auto x : data)
-                out << x << '\n';
+            std::vector<float> data = timed("input.parse", [&] { return input.values<float>(threads); });
+            timed("sort.quick", [&] {
+                if (order == "ascending")
+                    parallelQuickSort<float>(data, pool);
+                else
+                    parallelQuickSort<float>(data, pool, std::greater<float>());
+            });
+            if (config.unique) dropRepeats(data);
+
+            // Кратчайшая запись float, которая читается обратно без потерь
+            if (!writeOutput(outputFile, data.size(), [&](size_t i) { return data[i]; }, threads)) return 1;
+        } else if (type == "record") {
+            if (!timed("sort.records", [&] {
+                    return sortRecordsToFile(input, keySpec, order == "descending", config.unique, outputFile,
+                                             pool, threads);
+                })) {
+                cerr << "Error: Cannot write output file: " << outputFile << endl;
+                return 1;
+            }
         } else {
-            vector<string> data;
-            ifstream in(inputFile);
-            string s;
-            while (getline(in, s)) data.push_back(s);
-            if (order == "ascending") quickSort<string>(data, 0, data.size() - 1);
-            else quickSort<string>(data, 0, data.size() - 1, greater<string>());
-            ofstream out(outputFile);
-            for (auto& x : data) out << x << '\n';
+            // Строки — записи арены прямо в отображение файла, без копий
+            StringArena arena(input.data());
+            const auto lines = timed("input.parse", [&] { return input.lines(threads); });
+            arena.reserve(lines.size(), 0);
+            for (const auto& line : lines) arena.add(line);
+            timed("sort.string", [&] { stringSort(arena, order == "descending", &pool); });
+            if (config.unique) {
+                auto& records = arena.records;
+                records.erase(unique(records.begin(), records.end(),
+                                     [&arena](const StringRecord& a, const StringRecord& b) {
+                                         return arena.view(a) == arena.view(b);
+                                     }),
+                              records.end());
+            }
+            if (!writeOutput(outputFile, arena.size(), [&](size_t i) { return arena.view(arena.records[i]); },
+                             threads))
+                return 1;
         }
         cout << "Quick sort completed." << endl;
         return 0;
@@ -99,34 +324,56 @@ int main(int argc, char** argv) {
 
     // Внешняя сортировка
     if (mode == "-m" || mode == "--merge") {
+        bool ok;
         if (type == "int") {
-            int chunks = splitIntoChunks<int>(inputFile);
             if (order == "ascending") {
-                sortAllChunks<int>(inputFile, chunks);
-                mergeChunksToFile<int>(inputFile, chunks, outputFile);
+                int runs = 0;
+                ok = generateSortedRuns<int>(inputFile, runs, config) &&
+                     mergeChunksToFile<int>(inputFile, runs, outputFile, config);
             } else {
-                sortAllChunks<int>(inputFile, chunks, greater<int>());
-                mergeChunksToFile<int>(inputFile, chunks, outputFile, greater<int>());
+                int runs = 0;
+                ok = generateSortedRuns<int>(inputFile, runs, config, greater<int>()) &&
+                     mergeChunksToFile<int>(inputFile, runs, outputFile, config, greater<int>());
             }
         } else if (type == "float") {
-            int chunks = splitIntoChunks<float>(inputFile);
             if (order == "ascending") {
-                sortAllChunks<float>(inputFile, chunks);
-                mergeChunksToFile<float>(inputFile, chunks, outputFile);
+                int runs = 0;
+                ok = generateSortedRuns<float>(inputFile, runs, config) &&
+                     mergeChunksToFile<float>(inputFile, runs, outputFile, config);
             } else {
-                sortAllChunks<float>(inputFile, chunks, greater<float>());
-                mergeChunksToFile<float>(inputFile, chunks, outputFile, greater<float>());
+                int runs = 0;
+                ok = generateSortedRuns<float>(inputFile, runs, config, greater<float>()) &&
+                     mergeChunksToFile<float>(inputFile, runs, outputFile, config, greater<float>());
             }
+        } else if (type == "record") {
+            // Внешне сортируются только ключи записей (временный файл .keys),
+            // при слиянии каждый ключ заменяется своей строкой входа
+            MappedInput input(inputFile);
+            const string keysFile = inputFile + ".keys";
+            if (!writeRecordKeys(input, keySpec, order == "descending", keysFile)) {
+                cerr << "Error: Cannot write temporary file: " << keysFile << endl;
+                return 1;
+            }
+            int runs = 0;
+            ok = generateSortedRuns<string>(keysFile, runs, config) &&
+                 mergeChunksToFile<string>(keysFile, runs, outputFile, config, less<string>(),
+                                           GatherRecords{input.data(), config.unique});
+            std::remove(keysFile.c_str());
         } else {
-            int chunks = splitIntoChunks(inputFile);
             if (order == "ascending") {
-                sortAllChunks<string>(inputFile, chunks);
-                mergeChunksToFile<string>(inputFile, chunks, outputFile);
+                int runs = 0;
+                ok = generateSortedRuns<string>(inputFile, runs, config) &&
+                     mergeChunksToFile<string>(inputFile, runs, outputFile, config);
             } else {
-                sortAllChunks<string>(inputFile, chunks, greater<string>());
-                mergeChunksToFile<string>(inputFile, chunks, outputFile, greater<string>());
+                int runs = 0;
+                ok = generateSortedRuns<string>(inputFile, runs, config, greater<string>()) &&
+                     mergeChunksToFile<string>(inputFile, runs, outputFile, config, greater<string>());
             }
         }
+        if (!ok) {
+            cerr << "Error: External merge sort failed, output file is missing or incomplete: " << outputFile << endl;
+            return 1;
+        }
         cout << "External merge sort completed." << endl;
         return 0;
     }
@@ -1,10 +1,16 @@
 #include "ConcaveHull.hpp"
 
 #include <cmath>
+#include <cstdint>
 #include <algorithm>
 #include <unordered_set>
-#include <set>
 #include <iostream>
+#include <cstdlib>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -59,14 +65,31 @@ namespace geom {
         return sqrt(s * (s - ab) * (s - bc) * (s - ca));
     }
 
-    bool isCrossHull(list<Point>::iterator p_H, const Point& newP, const list<Point>& conHull) {
-        if (conHull.size() < 3) return false;
-
+    // Пересекает ли отрезок p-q отрезок a-b, включая касание концом
+    bool segmentsCross(const Point& p, const Point& q, const Point& a, const Point& b) {
         auto onSegment = [](const Point& p, const Point& q, const Point& r) {
             return q.x <= max(p.x, r.x) && q.x >= min(p.x, r.x) &&
                    q.y <= max(p.y, r.y) && q.y >= min(p.y, r.y);
         };
 
+        int o1 = orientation(p, q, a);
+        int o2 = orientation(p, q, b);
+        int o3 = orientation(a, b, p);
+        int o4 = orientation(a, b, q);
+
+        if (o1 != o2 && o3 != o4)
+            return true;
+
+        if (o1 == 0 && onSegment(p, a, q)) return true;
+        if (o2 == 0 && onSegment(p, b, q)) return true;
+        if (o3 == 0 && onSegment(a, p, b)) return true;
+        if (o4 == 0 && onSegment(a, q, b)) return true;
+        return false;
+    }
+
+    bool isCrossHull(list<Point>::iterator p_H, const Point& newP, const list<Point>& conHull) {
+        if (conHull.size() < 3) return false;
+
         auto it1 = conHull.begin();
         auto it2 = next(it1);
         for (; it2 != conHull.end(); ++it1, ++it2) {
@@ -75,18 +98,8 @@ namespace geom {
             if (&(*it1) == &(*p_H) || &(*it2) == &(*p_H) || *it1 == newP || *it2 == newP)
                 continue;
 
-            int o1 = orientation(*p_H, newP, *it1);
-            int o2 = orientation(*p_H, newP, *it2);
-            int o3 = orientation(*it1, *it2, *p_H);
-            int o4 = orientation(*it1, *it2, newP);
-
-            if (o1 != o2 && o3 != o4)
+            if (segmentsCross(*p_H, newP, *it1, *it2))
                 return true;
-
-            if (o1 == 0 && onSegment(*p_H, *it1, newP)) return true;
-            if (o2 == 0 && onSegment(*p_H, *it2, newP)) return true;
-            if (o3 == 0 && onSegment(*it1, *p_H, *it2)) return true;
-            if (o4 == 0 && onSegment(*it1, newP, *it2)) return true;
         }
 
         auto it_last = prev(conHull.end());
@@ -94,18 +107,8 @@ namespace geom {
         if ((&(*it_last) != &(*p_H) && &(*it_first) != &(*p_H)) &&
             !(*it_last == newP && *it_first == newP)) {
 
-            int o1 = orientation(*p_H, newP, *it_last);
-            int o2 = orientation(*p_H, newP, *it_first);
-            int o3 = orientation(*it_last, *it_first, *p_H);
-            int o4 = orientation(*it_last, *it_first, newP);
-
-            if (o1 != o2 && o3 != o4)
+            if (segmentsCross(*p_H, newP, *it_last, *it_first))
                 return true;
-
-            if (o1 == 0 && onSegment(*p_H, *it_last, newP)) return true;
-            if (o2 == 0 && onSegment(*p_H, *it_first, newP)) return true;
-            if (o3 == 0 && onSegment(*it_last, *p_H, *it_first)) return true;
-            if (o4 == 0 && onSegment(*it_last, newP, *it_first)) return true;
         }
 
         return false;
@@ -125,103 +128,641 @@ namespace geom {
 
 
 
+// ===== HullRing =====
+// Вогнутая оболочка — кольцевой двусвязный список на массивах: вершины лежат
+// в pts в порядке появления, next/prev — индексы соседей. Обход начинается с
+// вершины 0, первой вершины выпуклой оболочки; ребро tail -> 0 замыкает кольцо.
+
+struct HullRing {
+    std::vector<Point> pts;
+    std::vector<uint32_t> next, prev;
+
+    HullRing(const std::vector<Point>& H, size_t capacity) {
+        pts.reserve(capacity);
+        next.reserve(capacity);
+        prev.reserve(capacity);
+        pts.assign(H.begin(), H.end());
+        uint32_t n = static_cast<uint32_t>(H.size());
+        for (uint32_t i = 0; i < n; ++i) {
+            next.push_back(i + 1 < n ? i + 1 : 0);
+            prev.push_back(i > 0 ? i - 1 : n - 1);
+        }
+    }
+
+    size_t size() const { return pts.size(); }
+
+    // Вставляет p между v и next[v]; возвращает индекс новой вершины
+    uint32_t insertAfter(uint32_t v, const Point& p) {
+        uint32_t id = static_cast<uint32_t>(pts.size());
+        uint32_t w = next[v];
+        pts.push_back(p);
+        next.push_back(w);
+        prev.push_back(v);
+        next[v] = id;
+        prev[w] = id;
+        return id;
+    }
+
+    std::list<Point> toList() const {
+        std::list<Point> out;
+        if (pts.empty()) return out;
+        uint32_t v = 0;
+        do {
+            out.push_back(pts[v]);
+            v = next[v];
+        } while (v != 0);
+        return out;
+    }
+};
+
+// ===== SegmentGrid =====
+// Рёбра вогнутой оболочки в равномерной сетке над выпуклой оболочкой:
+// ребро лежит в каждой ячейке, через которую проходит. Проверка пересечения
+// смотрит только рёбра из ячеек вокруг нового отрезка, а не всю оболочку.
+// Ребро задаётся начальной вершиной v (v -> next[v]), в ячейках лежат
+// индексы вершин.
+
+class SegmentGrid {
+public:
+    // Сетка примерно из cellsWanted ячеек над bbox вершин ring
+    SegmentGrid(const HullRing& ring, size_t cellsWanted) : ring(ring) {
+        if (ring.pts.empty()) return;
+        minX = maxX = ring.pts[0].x;
+        minY = maxY = ring.pts[0].y;
+        for (const auto& p : ring.pts) {
+            minX = std::min(minX, p.x); maxX = std::max(maxX, p.x);
+            minY = std::min(minY, p.y); maxY = std::max(maxY, p.y);
+        }
+        double w = std::max<double>(maxX - minX, 1e-6);
+        double h = std::max<double>(maxY - minY, 1e-6);
+        cellSize = std::sqrt(w * h / std::max<size_t>(cellsWanted, 1));
+        nx = static_cast<size_t>(w / cellSize) + 1;
+        ny = static_cast<size_t>(h / cellSize) + 1;
+        cells.assign(nx * ny, {});
+    }
+
+    // Ребро v -> next[v]
+    void add(uint32_t v) {
+        if (mark.size() < ring.size()) mark.resize(ring.size(), 0);
+        forEachCell(ring.pts[v], ring.pts[ring.next[v]], 0, [&](std::vector<uint32_t>& cell) {
+            cell.push_back(v);
+            return true;
+        });
+    }
+
+    // Вызывается до того, как next[v] изменится
+    void remove(uint32_t v) {
+        forEachCell(ring.pts[v], ring.pts[ring.next[v]], 0, [&](std::vector<uint32_t>& cell) {
+            auto it = std::find(cell.begin(), cell.end(), v);
+            if (it != cell.end()) {
+                *it = cell.back();
+                cell.pop_back();
+            }
+            return true;
+        });
+    }
+
+    // Те же проверки, что у geom::isCrossHull, но только для рёбер рядом с
+    // отрезком pb -> newP. Ячейки берутся с запасом в одну: orientation
+    // считает почти коллинеарные точки коллинеарными
+    bool crosses(uint32_t pb, const Point& newP) {
+        if (ring.size() < 3) return false;
+        ++query;
+        const Point& p = ring.pts[pb];
+        return !forEachCell(p, newP, 1, [&](std::vector<uint32_t>& cell) {
+            for (uint32_t v : cell) {
+                if (mark[v] == query) continue;
+                mark[v] = query;
+
+                uint32_t w = ring.next[v];
+                if (v == pb || w == pb) continue;
+                const Point& a = ring.pts[v];
+                const Point& b = ring.pts[w];
+                bool closing = w == 0;
+                if (closing ? (a == newP && b == newP) : (a == newP || b == newP))
+                    continue;
+                if (geom::segmentsCross(p, newP, a, b))
+                    return false;
+            }
+            return true;
+        });
+    }
+
+private:
+    // visit(cell) для ячеек, через которые проходит отрезок a-b,
+    // расширенных на pad ячеек во все стороны. visit возвращает false, чтобы
+    // остановить обход; тогда и forEachCell возвращает false
+    template<typename Visit>
+    bool forEachCell(const Point& a, const Point& b, size_t pad, Visit&& visit) {
+        if (cells.empty()) return true;
+        size_t r0 = row(std::min(a.y, b.y)), r1 = row(std::max(a.y, b.y));
+        r0 = r0 > pad ? r0 - pad : 0;
+        r1 = std::min(r1 + pad, ny - 1);
+        for (size_t r = r0; r <= r1; ++r) {
+            // Часть отрезка в полосе строки r
+            double lo = std::max<double>(minY + r * cellSize, std::min(a.y, b.y));
+            double hi = std::min<double>(minY + (r + 1) * cellSize, std::max(a.y, b.y));
+            double xa = a.x, xb = b.x;
+            if (a.y != b.y && lo <= hi) {
+                xa = a.x + (b.x - a.x) * (lo - a.y) / (b.y - a.y);
+                xb = a.x + (b.x - a.x) * (hi - a.y) / (b.y - a.y);
+            }
+            size_t c0 = column(std::min(xa, xb)), c1 = column(std::max(xa, xb));
+            // Строки запаса и соседние строки получают столбцы всего отрезка
+            if (lo > hi) {
+                c0 = column(std::min(a.x, b.x));
+                c1 = column(std::max(a.x, b.x));
+            }
+            c0 = c0 > pad ? c0 - pad : 0;
+            c1 = std::min(c1 + pad, nx - 1);
+            for (size_t c = c0; c <= c1; ++c)
+                if (!visit(cells[r * nx + c])) return false;
+        }
+        return true;
+    }
+
+    size_t column(double x) const {
+        double c = std::floor((x - minX) / cellSize);
+        return static_cast<size_t>(std::clamp(c, 0.0, static_cast<double>(nx - 1)));
+    }
+
+    size_t row(double y) const {
+        double r = std::floor((y - minY) / cellSize);
+        return static_cast<size_t>(std::clamp(r, 0.0, static_cast<double>(ny - 1)));
+    }
+
+    const HullRing& ring;
+    float minX = 0, maxX = 0, minY = 0, maxY = 0;
+    double cellSize = 1;
+    size_t nx = 0, ny = 0;
+    std::vector<std::vector<uint32_t>> cells;
+    std::vector<uint32_t> mark;   // номер последнего запроса: ребро из нескольких ячеек проверяется один раз
+    uint32_t query = 0;
+};
+
+// ===== EdgeQueue =====
+// Рёбра оболочки в двоичной куче, сверху — самое длинное. Из кучи уходит
+// только верхнее ребро: его разбивают или на нём построение заканчивается,
+// поэтому позиции рёбер в куче отслеживать не нужно.
+
 struct Edge {
-    std::list<Point>::iterator prev;
-    std::list<Point>::iterator next;
     float length;
+    uint32_t from, to;   // вершины HullRing
+};
 
-    Edge(std::list<Point>::iterator p1, std::list<Point>::iterator p2)
-        : prev(p1), next(p2), length(geom::distSq(*p1, *p2)) {}
+class EdgeQueue {
+    std::vector<Edge> heap;
+    HullRing& ring;
+    SegmentGrid segments;   // те же рёбра для проверки пересечений
+
+    // Верхним должно стать b. Рёбра почти равной длины упорядочены по
+    // вершинам — по порядку их появления в оболочке
+    static bool below(const Edge& a, const Edge& b) {
+        if (fabs(a.length - b.length) > 1e-9f)
+            return a.length < b.length;
+        return std::tie(a.from, a.to) > std::tie(b.from, b.to);
+    }
 
-    bool operator<(const Edge& other) const {
-    if (fabs(length - other.length) > 1e-9f)
-        return length > other.length; 
+    void push(uint32_t from, uint32_t to) {
+        heap.push_back({geom::distSq(ring.pts[from], ring.pts[to]), from, to});
+        std::push_heap(heap.begin(), heap.end(), below);
+        segments.add(from);
+    }
 
+public:
+    EdgeQueue(HullRing& ring_, size_t gridCells)
+        : ring(ring_), segments(ring_, gridCells) {
+        if (ring.size() < 2) return;
+        heap.reserve(ring.pts.capacity());
+        for (uint32_t v = 0; v < ring.size(); ++v)
+            push(v, ring.next[v]);
+    }
 
-    return std::tuple<Point*, Point*>(&(*prev), &(*next)) <
-       std::tuple<Point*, Point*>(&(*other.prev), &(*other.next));
+    // Вставляет p в самое длинное ребро; возвращает индекс новой вершины
+    uint32_t splitEdge(const Point& p) {
+        Edge top = heap.front();
+        std::pop_heap(heap.begin(), heap.end(), below);
+        heap.pop_back();
+
+        segments.remove(top.from);
+        uint32_t v = ring.insertAfter(top.from, p);
+        push(top.from, v);
+        push(v, top.to);
+        return v;
+    }
 
+    // geom::isCrossHull по рёбрам рядом с отрезком pb -> newP
+    bool crossesHull(uint32_t pb, const Point& newP) {
+        return segments.crosses(pb, newP);
     }
 
+    const Edge& getMaxEdge() const {
+        return heap.front();
+    }
+
+    bool empty() const {
+        return heap.empty();
+    }
 };
 
+// ===== CandidateGrid =====
+// Равномерная сетка над кандидатами G, в среднем ~2 точки на ячейку.
+// Индексы точек лежат подряд по ячейкам, рядом — их координаты отдельными
+// массивами xs, ys (SoA) для ядра оценки. Из ячеек только удаляют, поэтому
+// удаление — обмен с последним элементом ячейки за O(1); освободившееся
+// место помечается x = NaN, и ядро его пропускает. Так ячейки одной строки
+// прямоугольника читаются одним непрерывным отрезком.
 
-struct EdgeKeyHash {
-    size_t operator()(const std::pair<Point*, Point*>& p) const {
-        return reinterpret_cast<uintptr_t>(p.first) ^ reinterpret_cast<uintptr_t>(p.second);
+class CandidateGrid {
+public:
+    // Прямоугольник ячеек, границы включительно
+    struct Cells {
+        size_t x0, y0, x1, y1;
+    };
+
+    explicit CandidateGrid(const std::vector<Point>& G) {
+        size_t n = G.size();
+        cellOf.resize(n);
+        slot.resize(n);
+        if (n == 0) return;
+
+        minX = maxX = G[0].x;
+        minY = maxY = G[0].y;
+        for (const auto& p : G) {
+            minX = std::min(minX, p.x); maxX = std::max(maxX, p.x);
+            minY = std::min(minY, p.y); maxY = std::max(maxY, p.y);
+        }
+        double w = std::max<double>(maxX - minX, 1e-6);
+        double h = std::max<double>(maxY - minY, 1e-6);
+        double cellSize = std::sqrt(w * h / std::max<double>(n / 2.0, 1.0));
+        nx = std::clamp<size_t>(static_cast<size_t>(w / cellSize) + 1, 1, n);
+        ny = std::clamp<size_t>(static_cast<size_t>(h / cellSize) + 1, 1, std::max<size_t>(n / nx, 1));
+        invX = nx / w;
+        invY = ny / h;
+
+        start.assign(nx * ny + 1, 0);
+        for (size_t i = 0; i < n; ++i) {
+            cellOf[i] = static_cast<uint32_t>(cellIndex(G[i].x, G[i].y));
+            ++start[cellOf[i] + 1];
+        }
+        for (size_t c = 0; c < nx * ny; ++c) start[c + 1] += start[c];
+        count.assign(nx * ny, 0);
+        items.resize(n);
+        xs.resize(n);
+        ys.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t c = cellOf[i];
+            slot[i] = start[c] + count[c]++;
+            items[slot[i]] = static_cast<uint32_t>(i);
+            xs[slot[i]] = G[i].x;
+            ys[slot[i]] = G[i].y;
+        }
+    }
+
+    // Ячейки, пересекающие прямоугольник [x0, x1] x [y0, y1]
+    Cells cellsIn(double x0, double y0, double x1, double y1) const {
+        return {column(x0), row(y0), column(x1), row(y1)};
+    }
+
+    Cells all() const {
+        return {0, 0, nx - 1, ny - 1};
+    }
+
+    static size_t size(const Cells& cells) {
+        return (cells.x1 - cells.x0 + 1) * (cells.y1 - cells.y0 + 1);
+    }
+
+    // Примерно столько точек из remaining в прямоугольнике при равномерной плотности
+    size_t estimate(const Cells& cells, size_t remaining) const {
+        return size(cells) * remaining / (nx * ny);
     }
-};
 
-struct EdgeKeyEq {
-    bool operator()(const std::pair<Point*, Point*>& a, const std::pair<Point*, Point*>& b) const {
-        return a.first == b.first && a.second == b.second;
+    // visit(ids, xs, ys, n) для непрерывных отрезков, покрывающих ячейки
+    // [first, last) прямоугольника (ячейки нумеруются построчно): соседние
+    // ячейки строки идут одним отрезком, вместе с удалёнными местами (x = NaN)
+    template<typename Visit>
+    void forEachRun(const Cells& cells, size_t first, size_t last, Visit&& visit) const {
+        size_t width = cells.x1 - cells.x0 + 1;
+        for (size_t k = first; k < last;) {
+            size_t rowEnd = std::min(last, (k / width + 1) * width);
+            size_t c = (cells.y0 + k / width) * nx + cells.x0 + k % width;
+            size_t cLast = c + (rowEnd - k) - 1;
+            uint32_t begin = start[c], end = start[cLast] + count[cLast];
+            if (end > begin)
+                visit(items.data() + begin, xs.data() + begin, ys.data() + begin, end - begin);
+            k = rowEnd;
+        }
     }
+
+    // Повторяет removeCandidate: точка idx удаляется, последняя точка G
+    // (индекс last) переезжает на её место
+    void remove(size_t idx, size_t last) {
+        uint32_t c = cellOf[idx];
+        uint32_t tail = start[c] + --count[c];
+        items[slot[idx]] = items[tail];
+        xs[slot[idx]] = xs[tail];
+        ys[slot[idx]] = ys[tail];
+        slot[items[tail]] = slot[idx];
+        xs[tail] = std::numeric_limits<float>::quiet_NaN();
+        if (idx != last) {
+            items[slot[last]] = static_cast<uint32_t>(idx);
+            slot[idx] = slot[last];
+            cellOf[idx] = cellOf[last];
+        }
+    }
+
+private:
+    size_t column(double x) const {
+        double c = std::floor((x - minX) * invX);
+        return static_cast<size_t>(std::clamp(c, 0.0, static_cast<double>(nx - 1)));
+    }
+
+    size_t row(double y) const {
+        double r = std::floor((y - minY) * invY);
+        return static_cast<size_t>(std::clamp(r, 0.0, static_cast<double>(ny - 1)));
+    }
+
+    size_t cellIndex(float x, float y) const {
+        return row(y) * nx + column(x);
+    }
+
+    float minX = 0, maxX = 0, minY = 0, maxY = 0;
+    double invX = 1, invY = 1;
+    size_t nx = 1, ny = 1;
+    std::vector<uint32_t> start;    // начало ячейки в items
+    std::vector<uint32_t> count;    // сколько точек осталось в ячейке
+    std::vector<uint32_t> items;    // индексы G по ячейкам
+    std::vector<float> xs, ys;      // координаты тех же точек
+    std::vector<uint32_t> slot;     // позиция точки G[i] в items
+    std::vector<uint32_t> cellOf;   // ячейка точки G[i]
 };
 
-class EdgeQueue {
-    std::set<std::shared_ptr<Edge>, 
-             bool(*)(const std::shared_ptr<Edge>&, const std::shared_ptr<Edge>&)> sortedEdges;
+// Ячейки, в которых могут лежать точки, проходящие фильтр
+// d1 + d2 - qd <= gamma * min(d1, d2). Так как min(d1, d2) <= (d1 + d2) / 2,
+// при gamma < 2 это эллипс с фокусами pb, pe и суммой расстояний
+// 2 * qd / (2 - gamma); при gamma >= 2 фильтр ничего не отсекает
+static CandidateGrid::Cells searchCells(const CandidateGrid& grid, const Point& pb, const Point& pe,
+                                        double qd, double gamma) {
+    if (gamma >= 2) return grid.all();
+    double a = (gamma <= 0 ? qd : 2 * qd / (2 - gamma)) / 2;
+    double b = std::sqrt(std::max(a * a - qd * qd / 4, 0.0));
+    double ux = qd > 0 ? (pe.x - pb.x) / qd : 1;
+    double uy = qd > 0 ? (pe.y - pb.y) / qd : 0;
+    double hx = std::sqrt(a * a * ux * ux + b * b * uy * uy);
+    double hy = std::sqrt(a * a * uy * uy + b * b * ux * ux);
+    double pad = 1e-4 * a + 1e-6;   // запас на округление float в расстояниях
+    double cx = (pb.x + pe.x) / 2.0, cy = (pb.y + pe.y) / 2.0;
+    return grid.cellsIn(cx - hx - pad, cy - hy - pad, cx + hx + pad, cy + hy + pad);
+}
 
-    std::unordered_map<std::pair<Point*, Point*>, std::shared_ptr<Edge>, EdgeKeyHash, EdgeKeyEq> edgeMap;
+// ===== Оценка кандидатов =====
+// Для каждой точки отрезка: фильтр эллипса d1 + d2 - qd <= gamma * min(d1, d2)
+// и площадь треугольника pb, pt, pe по формуле Герона, как в
+// geom::triangleSquare. Прошедшие фильтр точки добавляются в порядке отрезка
+// парами (площадь, индекс в G), а при площади NaN (почти вырожденный
+// треугольник) — в список nan.
+//
+// Расстояния считаются во float, как geom::dist, площадь — в double.
+// Векторные ядра (SSE2 — 4 точки, AVX2 — 8 точек за шаг) выполняют те же
+// операции IEEE в том же порядке, что и скалярное, без FMA, а корни IEEE
+// округляются точно, поэтому результат совпадает бит в бит (проверяется
+// тестом check_kernels). Если скалярный путь собрать с сокращением в FMA
+// (например, -march=native), значения могут разойтись на 1 ulp, и выбор
+// может отличаться только между кандидатами с такой разницей площадей.
+// Ядро выбирается один раз по CPUID; переменная окружения
+// CONH_KERNEL=scalar|sse2|avx2 задаёт его явно (avx2 без поддержки
+// процессором заменяется на sse2, на не-x86 всегда скалярное).
+
+struct EdgeQuery {
+    float bx, by, ex, ey;   // концы ребра pb, pe
+    double qd, gamma;
+};
 
-    std::list<Point>& hull;
+// Кандидаты одной части перебора
+struct ScoredPart {
+    std::vector<std::pair<double, uint32_t>> scored;
+    std::vector<uint32_t> nan;
+};
 
-    static bool edgeCompare(const std::shared_ptr<Edge>& a, const std::shared_ptr<Edge>& b) {
-        return *a < *b;
+using ScoreKernel = void (*)(const EdgeQuery&, const uint32_t*, const float*, const float*, size_t, ScoredPart&);
+
+static void scoreScalar(const EdgeQuery& q, const uint32_t* ids, const float* xs, const float* ys, size_t n,
+                        ScoredPart& out) {
+    for (size_t k = 0; k < n; ++k) {
+        float ax = xs[k] - q.bx, ay = ys[k] - q.by;
+        float cx = q.ex - xs[k], cy = q.ey - ys[k];
+        double d1 = std::sqrt(ax * ax + ay * ay);
+        double d2 = std::sqrt(cx * cx + cy * cy);
+        if (!(d1 + d2 - q.qd <= q.gamma * std::min(d1, d2))) continue;   // NaN — удалённое место
+
+        double s = (d1 + d2 + q.qd) * 0.5;
+        double S = std::sqrt(s * (s - d1) * (s - d2) * (s - q.qd));
+        if (std::isnan(S)) out.nan.push_back(ids[k]);
+        else out.scored.emplace_back(S, ids[k]);
     }
+}
 
-public:
-    EdgeQueue(std::list<Point>& hull_) 
-        : hull(hull_), sortedEdges(edgeCompare) {
-        buildFromHull();
+#if defined(__x86_64__) || defined(__i386__)
+
+// Полосы double одной половины: d1, d2 уже расширены из float.
+// Прошедшие фильтр полосы выдаются по возрастанию номера
+#define CONH_SCORE_HALF(PD, P, SFX, CMPLE, LANES, IDS)                                      \
+    {                                                                                       \
+        PD lhs = P##_sub_##SFX(P##_add_##SFX(d1, d2), qd);                                  \
+        PD rhs = P##_mul_##SFX(gamma, P##_min_##SFX(d1, d2));                               \
+        int pass = P##_movemask_##SFX(CMPLE(lhs, rhs));                                     \
+        if (pass) {                                                                         \
+            PD s = P##_mul_##SFX(P##_add_##SFX(P##_add_##SFX(d1, d2), qd), half);           \
+            PD prod = P##_mul_##SFX(s, P##_sub_##SFX(s, d1));                               \
+            prod = P##_mul_##SFX(prod, P##_sub_##SFX(s, d2));                               \
+            prod = P##_mul_##SFX(prod, P##_sub_##SFX(s, qd));                               \
+            alignas(32) double S[LANES];                                                    \
+            P##_store_##SFX(S, P##_sqrt_##SFX(prod));                                       \
+            for (; pass; pass &= pass - 1) {                                                \
+                int lane = __builtin_ctz(pass);                                             \
+                if (std::isnan(S[lane])) out.nan.push_back((IDS)[lane]);                    \
+                else out.scored.emplace_back(S[lane], (IDS)[lane]);                         \
+            }                                                                               \
+        }                                                                                   \
     }
 
-    void buildFromHull() {
-        sortedEdges.clear();
-        edgeMap.clear();
+#define CONH_CMPLE_SSE2(a, b) _mm_cmple_pd(a, b)
+#define CONH_CMPLE_AVX(a, b) _mm256_cmp_pd(a, b, _CMP_LE_OQ)
+
+__attribute__((target("sse2")))
+static void scoreSSE2(const EdgeQuery& q, const uint32_t* ids, const float* xs, const float* ys, size_t n,
+                      ScoredPart& out) {
+    const __m128 fbx = _mm_set1_ps(q.bx), fby = _mm_set1_ps(q.by);
+    const __m128 fex = _mm_set1_ps(q.ex), fey = _mm_set1_ps(q.ey);
+    const __m128d qd = _mm_set1_pd(q.qd), gamma = _mm_set1_pd(q.gamma), half = _mm_set1_pd(0.5);
+
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4) {
+        __m128 fx = _mm_loadu_ps(xs + k), fy = _mm_loadu_ps(ys + k);
+        __m128 ax = _mm_sub_ps(fx, fbx), ay = _mm_sub_ps(fy, fby);
+        __m128 cx = _mm_sub_ps(fex, fx), cy = _mm_sub_ps(fey, fy);
+        __m128 fd1 = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(ax, ax), _mm_mul_ps(ay, ay)));
+        __m128 fd2 = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)));
+        {
+            __m128d d1 = _mm_cvtps_pd(fd1), d2 = _mm_cvtps_pd(fd2);
+            CONH_SCORE_HALF(__m128d, _mm, pd, CONH_CMPLE_SSE2, 2, ids + k)
+        }
+        {
+            __m128d d1 = _mm_cvtps_pd(_mm_movehl_ps(fd1, fd1)), d2 = _mm_cvtps_pd(_mm_movehl_ps(fd2, fd2));
+            CONH_SCORE_HALF(__m128d, _mm, pd, CONH_CMPLE_SSE2, 2, ids + k + 2)
+        }
+    }
+    scoreScalar(q, ids + k, xs + k, ys + k, n - k, out);
+}
 
-        if (hull.size() < 2) return;
-        auto it = hull.begin();
-        auto prev = it++;
-        for (; it != hull.end(); ++it, ++prev) {
-            addEdge(prev, it);
+__attribute__((target("avx2")))
+static void scoreAVX2(const EdgeQuery& q, const uint32_t* ids, const float* xs, const float* ys, size_t n,
+                      ScoredPart& out) {
+    const __m256 fbx = _mm256_set1_ps(q.bx), fby = _mm256_set1_ps(q.by);
+    const __m256 fex = _mm256_set1_ps(q.ex), fey = _mm256_set1_ps(q.ey);
+    const __m256d qd = _mm256_set1_pd(q.qd), gamma = _mm256_set1_pd(q.gamma), half = _mm256_set1_pd(0.5);
+
+    size_t k = 0;
+    for (; k + 8 <= n; k += 8) {
+        __m256 fx = _mm256_loadu_ps(xs + k), fy = _mm256_loadu_ps(ys + k);
+        __m256 ax = _mm256_sub_ps(fx, fbx), ay = _mm256_sub_ps(fy, fby);
+        __m256 cx = _mm256_sub_ps(fex, fx), cy = _mm256_sub_ps(fey, fy);
+        __m256 fd1 = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(ax, ax), _mm256_mul_ps(ay, ay)));
+        __m256 fd2 = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(cx, cx), _mm256_mul_ps(cy, cy)));
+        {
+            __m256d d1 = _mm256_cvtps_pd(_mm256_castps256_ps128(fd1));
+            __m256d d2 = _mm256_cvtps_pd(_mm256_castps256_ps128(fd2));
+            CONH_SCORE_HALF(__m256d, _mm256, pd, CONH_CMPLE_AVX, 4, ids + k)
+        }
+        {
+            __m256d d1 = _mm256_cvtps_pd(_mm256_extractf128_ps(fd1, 1));
+            __m256d d2 = _mm256_cvtps_pd(_mm256_extractf128_ps(fd2, 1));
+            CONH_SCORE_HALF(__m256d, _mm256, pd, CONH_CMPLE_AVX, 4, ids + k + 4)
         }
-        addEdge(--hull.end(), hull.begin());
     }
+    scoreScalar(q, ids + k, xs + k, ys + k, n - k, out);
+}
+
+#undef CONH_CMPLE_SSE2
+#undef CONH_CMPLE_AVX
+#undef CONH_SCORE_HALF
+
+#endif
+
+static ScoreKernel pickScoreKernel() {
+    const char* forced = std::getenv("CONH_KERNEL");
+    std::string name = forced ? forced : "";
+    if (name == "scalar") return scoreScalar;
+#if defined(__x86_64__) || defined(__i386__)
+    if (name == "sse2") return scoreSSE2;
+    if ((name.empty() || name == "avx2") && __builtin_cpu_supports("avx2")) return scoreAVX2;
+    return scoreSSE2;
+#else
+    return scoreScalar;
+#endif
+}
+
+static const ScoreKernel scoreCandidates = pickScoreKernel();
 
-    void addEdge(std::list<Point>::iterator p1, std::list<Point>::iterator p2) {
-        auto edge = std::make_shared<Edge>(p1, p2);
-        sortedEdges.insert(edge);
-        edgeMap[{&(*p1), &(*p2)}] = edge;
+// ===== WorkerPool =====
+// Постоянные потоки для перебора кандидатов: создаются один раз на
+// построение оболочки, а не на каждое ребро. run(n, fn) делит [0, n) на
+// size() частей, часть 0 считает вызывающий поток; возврат — когда готовы
+// все части (барьер). Между запусками потоки спят на condition_variable.
+
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned threads) {
+        for (unsigned t = 1; t < threads; ++t)
+            workers.emplace_back([this, t] { loop(t); });
     }
 
-    void removeEdge(std::list<Point>::iterator p1, std::list<Point>::iterator p2) {
-        auto key = std::make_pair(&(*p1), &(*p2));
-        auto it = edgeMap.find(key);
-        if (it != edgeMap.end()) {
-            sortedEdges.erase(it->second);
-            edgeMap.erase(it);
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+            ++generation;
         }
+        wake.notify_all();
+        for (auto& w : workers) w.join();
     }
 
-    void splitEdge(std::list<Point>::iterator ptNew) {
-        auto maxEdge = *sortedEdges.begin();
-        auto prev = maxEdge->prev;
-        auto next = maxEdge->next;
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
 
-        removeEdge(prev, next);
-        addEdge(prev, ptNew);
-        addEdge(ptNew, next);
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // fn(part, begin, end) для каждой части
+    template<typename Fn>
+    void run(size_t n, Fn& fn) {
+        if (workers.empty()) {
+            fn(0u, size_t{0}, n);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            call = [](void* f, unsigned t, size_t b, size_t e) { (*static_cast<Fn*>(f))(t, b, e); };
+            total = n;
+            pending = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+        runPart(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
     }
 
-    Edge getMaxEdge() const {
-        return **sortedEdges.begin();
+private:
+    void runPart(unsigned t) {
+        size_t chunk = (total + size() - 1) / size();
+        size_t begin = std::min(total, t * chunk);
+        call(job, t, begin, std::min(total, begin + chunk));
     }
 
-    bool empty() const {
-        return sortedEdges.empty();
+    void loop(unsigned t) {
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return generation != seen; });
+            seen = generation;
+            if (stop) return;
+            lock.unlock();
+            runPart(t);
+            lock.lock();
+            if (--pending == 0) done.notify_one();
+        }
     }
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    uint64_t generation = 0;
+    size_t pending = 0;
+    bool stop = false;
+    void* job = nullptr;
+    void (*call)(void*, unsigned, size_t, size_t) = nullptr;
+    size_t total = 0;
 };
+
+// Параллельная свёртка [0, n): map(acc, begin, end) копит результат части в
+// acc — свой у каждой части, переиспользуется между вызовами. После барьера
+// combine(acc) вызывается для частей по порядку в вызывающем потоке.
+// serial — посчитать всё одной частью в вызывающем потоке
+template<typename Acc, typename Map, typename Combine>
+void parallelReduce(WorkerPool& pool, std::vector<Acc>& accs, size_t n, bool serial, Map&& map,
+                    Combine&& combine) {
+    accs.resize(pool.size());
+    if (serial) {
+        map(accs[0], 0, n);
+        combine(accs[0]);
+        return;
+    }
+    auto part = [&](unsigned t, size_t begin, size_t end) { map(accs[t], begin, end); };
+    pool.run(n, part);
+    for (auto& acc : accs) combine(acc);
+}
+
 // ===== minConvexHull =====
 
 minConvexHull::minConvexHull(const vector<Point>& points) {
@@ -295,82 +836,101 @@ ConcaveHull::ConcaveHull(const std::vector<Point>& points)
     nH = H.size();
 }
 
-inline void removeCandidate(std::vector<Point>& G, size_t idx) {
+// Меньше стольких кандидатов в окрестности ребра пул не будится
+constexpr size_t PARALLEL_MIN_CANDIDATES = 4096;
+
+inline void removeCandidate(std::vector<Point>& G, CandidateGrid& grid, size_t idx) {
+    grid.remove(idx, G.size() - 1);
     G[idx] = G.back();
     G.pop_back();
 }
 
 
 std::list<Point> ConcaveHull::__getconcavehull() {
-    std::list<Point> conHull(H.begin(), H.end());
-    EdgeQueue edgesq(conHull);
-
-    while (true) {
+    HullRing conHull(H, H.size() + G.size());
+    // Ячеек сетки рёбер — по одной на 64 точки: вершин в оболочке намного
+    // меньше, чем точек, а в пустых ячейках запрос только теряет время
+    EdgeQueue edgesq(conHull, (H.size() + G.size()) / 64);
+    CandidateGrid grid(G);
+    WorkerPool pool(nThreads ? nThreads : std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<ScoredPart> parts;
+    std::vector<std::pair<double, uint32_t>> scored;   // площадь и индекс в G
+    std::vector<uint32_t> nanIdx;                      // площадь не определена
+
+    while (!G.empty() && !edgesq.empty()) {
         Edge edge = edgesq.getMaxEdge();
-        auto pb_it = edge.prev;
-        auto pe_it = edge.next;
-        Point pb = *pb_it, pe = *pe_it;
+        uint32_t pb_id = edge.from;
+        Point pb = conHull.pts[edge.from], pe = conHull.pts[edge.to];
         double qd = geom::dist(pb, pe);
 
-        size_t Gsize = G.size();
-        int bestIdx = -1;
-        double globalMinS = std::numeric_limits<double>::infinity();
-        std::mutex mutex;
-
-        const unsigned numThreads = std::thread::hardware_concurrency();
-        std::vector<std::thread> threads;
-
-        for (unsigned t = 0; t < numThreads; ++t) {
-            threads.emplace_back([&, t]() {
-                size_t chunkSize = (Gsize + numThreads - 1) / numThreads;
-                size_t startIdx = t * chunkSize;
-                size_t endIdx = std::min(Gsize, startIdx + chunkSize);
-
-                double localMinS = std::numeric_limits<double>::infinity();
-                int localBest = -1;
-
-                for (size_t i = startIdx; i < endIdx; ++i) {
-                    const Point& pt = G[i];
-                    double d1 = geom::dist(pt, pb);
-                    double d2 = geom::dist(pe, pt);
-                    if (d1 + d2 - qd > gamma * std::min(d1, d2)) continue;
-
-                    double S = geom::triangleSquare(pb, pt, pe);
-                    if (S >= localMinS) continue;
-
-                    if (geom::isCrossHull(pb_it, pt, conHull)) continue;
-
-                    localMinS = S;
-                    localBest = static_cast<int>(i);
-                }
-
-                if (localBest >= 0) {
-                    std::lock_guard<std::mutex> lock(mutex);
-                    if (localMinS < globalMinS) {
-                        globalMinS = localMinS;
-                        bestIdx = localBest;
-                    }
-                }
+        // Кандидаты ищутся только в ячейках вокруг эллипса ребра, а не во всём
+        // G. Ячейки делятся между потоками пула; каждая часть прогоняет свои
+        // отрезки через ядро оценки, затем части склеиваются по порядку.
+        // Мелкий поиск идёт в вызывающем потоке: будить пул дороже самой работы
+        CandidateGrid::Cells cells = searchCells(grid, pb, pe, qd, gamma);
+        bool serial = grid.estimate(cells, G.size()) < PARALLEL_MIN_CANDIDATES;
+        EdgeQuery query{pb.x, pb.y, pe.x, pe.y, qd, gamma};
+        scored.clear();
+        nanIdx.clear();
+        parallelReduce(pool, parts, CandidateGrid::size(cells), serial,
+            [&](ScoredPart& part, size_t first, size_t last) {
+                part.scored.clear();
+                part.nan.clear();
+                grid.forEachRun(cells, first, last,
+                    [&](const uint32_t* ids, const float* xs, const float* ys, size_t n) {
+                        scoreCandidates(query, ids, xs, ys, n, part);
+                    });
+            },
+            [&](const ScoredPart& part) {
+                scored.insert(scored.end(), part.scored.begin(), part.scored.end());
+                nanIdx.insert(nanIdx.end(), part.nan.begin(), part.nan.end());
             });
+
+        // Проверка пересечения, самая дорогая часть, идёт от меньшей площади
+        // к большей до первого подходящего кандидата. Результат тот же, что у
+        // прохода по G с выбором первого минимума, хотя ячейки обходятся не в
+        // порядке G.
+        //
+        // Для почти вырожденного треугольника формула Герона даёт NaN, а NaN
+        // при проходе по G принимался всегда и сбрасывал минимум. Поэтому
+        // в счёт идут только кандидаты после последнего такого NaN без
+        // пересечения; если их нет, выбирается он сам
+        int bestIdx = -1;
+        std::sort(nanIdx.begin(), nanIdx.end(), std::greater<>());
+        for (uint32_t i : nanIdx) {
+            if (!edgesq.crossesHull(pb_id, G[i])) {
+                bestIdx = static_cast<int>(i);
+                break;
+            }
+        }
+        if (bestIdx >= 0) {
+            scored.erase(std::remove_if(scored.begin(), scored.end(), [&](const auto& c) {
+                return static_cast<int>(c.second) <= bestIdx;
+            }), scored.end());
         }
 
-        for (auto& th : threads) {
-            th.join();
+        auto worse = std::greater<std::pair<double, uint32_t>>();
+        std::make_heap(scored.begin(), scored.end(), worse);
+        while (!scored.empty()) {
+            std::pop_heap(scored.begin(), scored.end(), worse);
+            uint32_t i = scored.back().second;
+            scored.pop_back();
+            if (!edgesq.crossesHull(pb_id, G[i])) {
+                bestIdx = static_cast<int>(i);
+                break;
+            }
         }
 
         if (bestIdx < 0)
             break;
 
-        auto insertPos = std::next(pb_it);
-        auto newIt = conHull.insert(insertPos, G[bestIdx]);
-        edgesq.splitEdge(newIt);
-
-        removeCandidate(G, bestIdx);
+        edgesq.splitEdge(G[bestIdx]);
+        removeCandidate(G, grid, bestIdx);
     }
 
-    conhull = conHull;
-    cout << conHull.size() << endl;
-    return conHull;
+    conhull = conHull.toList();
+    cout << conhull.size() << endl;
+    return conhull;
 }
 
 
@@ -383,3 +943,7 @@ std::list<Point> ConcaveHull::getConcaveHull(double g) {
     gamma = g;
     return __getconcavehull();
 }
+
+void ConcaveHull::setThreads(unsigned n) {
+    nThreads = n;
+}
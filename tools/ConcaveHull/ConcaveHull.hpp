@@ -7,6 +7,7 @@
 #include <thread>
 #include <mutex>
 #include <future>
+#include <condition_variable>
 
 
 struct Point {
@@ -26,6 +27,7 @@ namespace geom {
     int orientation(const Point& a, const Point& b, const Point& c);
     bool compare(const Point& a, const Point& b);
     double triangleSquare(const Point& a, const Point& b, const Point& c);
+    bool segmentsCross(const Point& p, const Point& q, const Point& a, const Point& b);
     bool isCrossHull(std::list<Point>::iterator p_H, const Point& newP, const std::list<Point>& conHull);
     std::list<Point> subtract(const std::vector<Point>& set1, const std::vector<Point>& set2);
 }
@@ -47,12 +49,14 @@ public:
     ConcaveHull(const std::vector<Point>& points);
     std::list<Point> getConcaveHull();
     std::list<Point> getConcaveHull(double g);
+    void setThreads(unsigned n);   // 0 — по числу ядер
 
 private:
     std::vector<Point> G;     // кандидаты для вогнутости
     std::vector<Point> H;     // начальная выпуклая оболочка
     size_t nH;
     double gamma;
+    unsigned nThreads = 0;
     std::list<Point> conhull;
     std::list<Point> __getconcavehull();
 
@@ -15,6 +15,7 @@ int main(int argc, char** argv)
 {
     bool forceOverwrite = false;
     double gamma = 1.55;
+    unsigned threads = 0;
     const char* inputPath = nullptr;
     const char* outputPath = nullptr;
 
@@ -29,6 +30,18 @@ int main(int argc, char** argv)
                 cerr << "Error: Missing value after " << argv[i] << endl;
                 return 1;
             }
+        } else if ((strcmp(argv[i], "-t") == 0) || (strcmp(argv[i], "--threads") == 0)) {
+            if (i + 1 < argc) {
+                int n = atoi(argv[++i]);
+                if (n < 0) {
+                    cerr << "Error: Invalid thread count " << argv[i] << endl;
+                    return 1;
+                }
+                threads = static_cast<unsigned>(n);
+            } else {
+                cerr << "Error: Missing value after " << argv[i] << endl;
+                return 1;
+            }
         } else if (!inputPath) {
             inputPath = argv[i];
         } else if (!outputPath) {
@@ -43,7 +56,8 @@ int main(int argc, char** argv)
         cerr << "Usage: " << argv[0] << " [options] <input_file> <output_file>\n"
              << "Options:\n"
              << "  -f, --force            Overwrite output file without warning\n"
-             << "  -g, --gamma <value>    Set gamma value for ConcaveHull (default: 1.55)\n";
+             << "  -g, --gamma <value>    Set gamma value for ConcaveHull (default: 1.55)\n"
+             << "  -t, --threads <n>      Worker threads for candidate search (default: 0, all cores)\n";
         return 1;
     }
 
@@ -74,6 +88,7 @@ int main(int argc, char** argv)
     }
 
     ConcaveHull CH(points);
+    CH.setThreads(threads);
     list<Point> cnh = CH.getConcaveHull(gamma);
 
     for (const auto& pt : cnh) {
@@ -0,0 +1,21 @@
+#!/bin/sh
+# Оболочка 03_points.txt при нескольких gamma через каждое ядро оценки
+# кандидатов должна побайтно совпадать с эталоном в tests/expected.
+# Запуск: check_kernels.sh <conh> <каталог ConcaveHull>
+conh="$1"
+root="$2"
+out="${TMPDIR:-/tmp}/conh_check_$$.txt"
+status=0
+for gamma in 1.1 1.3 1.55 1.9 2.5; do
+    for kernel in scalar sse2 avx2; do
+        if ! CONH_KERNEL=$kernel "$conh" -f -g "$gamma" "$root/03_points.txt" "$out" >/dev/null; then
+            echo "FAIL: gamma=$gamma kernel=$kernel: conh exited with an error"
+            status=1
+        elif ! cmp -s "$out" "$root/tests/expected/03_points_g$gamma.txt"; then
+            echo "FAIL: gamma=$gamma kernel=$kernel: output differs from tests/expected/03_points_g$gamma.txt"
+            status=1
+        fi
+    done
+done
+rm -f "$out"
+exit $status
@@ -16,6 +16,8 @@
 #include <thread>
 #include <chrono>
 
+#include "OutputWriter.hpp"
+
 using namespace std;
 
 class DeleteRepeatsData {
@@ -42,7 +44,7 @@ private:
     unordered_set<Triple, TripleHash> seen_;
     
 public:
-    int deleteRepeatsDats(ifstream& in, ofstream& out) {
+    int deleteRepeatsDats(ifstream& in, OutputWriter& out) {
         string line;
         int count = 0;
 
@@ -55,7 +57,9 @@ public:
             if (seen_.find(t) == seen_.end()) {
                 seen_.insert(t);
                 ++count;
-                out << t.a << t.b << t.c <<  "\n";
+                out.write(t.a, ' ');
+                out.write(t.b, ' ');
+                out.write(t.c);
             }
         }
         return count;
@@ -82,13 +86,17 @@ int main(int argc, char** argv) {
 
     }
 
-    ofstream out(argv[2], ios::binary);
-    if (!out) {
+    OutputWriter out(argv[2]);
+    if (!out.ok()) {
         cerr << "Output file: create error" << endl;
         return 1;
     }
 
     int uniqueLines = DeleteRepeatsData().deleteRepeatsDats(data, out);
+    if (!out.close()) {
+        cerr << "Output file: write error" << endl;
+        return 1;
+    }
     cout << "In file " << argv[2] << " successfully wrote " << uniqueLines << " unique lines" << endl;
 
 